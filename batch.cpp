@@ -0,0 +1,89 @@
+#include <sstream>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "batch.h"
+#include "puzzle.h"
+#include "solver.h"
+
+
+std::string solvePuzzle(const Board &board, const SolveOptions &options) {
+  std::ostringstream line;
+  std::vector<Move> moves;
+  bool found;
+  if (options.cache != NULL && options.cache->lookup(board,options.max_moves,found,moves)) {
+    // a repeat, nothing to search
+  } else {
+    if (options.use_ida)
+      found = ida_solve(board,options.max_moves,moves);
+    else
+      found = bfs_solve(board,options.max_moves,moves,options.symmetry);
+    if (options.cache != NULL)
+      options.cache->store(board,options.max_moves,found,moves);
+  }
+  if (!found) {
+    line << "no solutions";
+    if (options.max_moves >= 0) line << " with " << options.max_moves << " or fewer moves";
+    return line.str();
+  }
+  line << moves.size() << " moves";
+  for (unsigned int k = 0; k < moves.size(); k++)
+    line << (k == 0 ? ": " : ", ") << board.getRobot(moves[k].robot) << " " << COMPASS_NAMES[moves[k].dir];
+  return line.str();
+}
+
+// the one line reported for a puzzle file
+static std::string solveOne(const std::string &filename, const SolveOptions &options, LayoutCache &layouts) {
+  Board board(1,1);
+  std::string error;
+  // only IDA* has any use for the shared layout tables
+  if (!readPuzzleFile(filename,board,error,options.use_ida ? &layouts : NULL))
+    return filename + ": ERROR " + error;
+  return filename + ": " + solvePuzzle(board,options);
+}
+
+void batch_solve(const std::vector<std::string> &files, const SolveOptions &options, std::ostream &ostr) {
+  std::vector<std::string> results(files.size());
+  std::vector<bool> done(files.size(),false);
+  std::atomic<unsigned int> next_file(0);
+  // lines go out in input order: whoever finishes the file at the
+  // front of the queue prints every finished line behind it too
+  std::mutex output_lock;
+  unsigned int next_line = 0;
+  // puzzles on the same board share their wall tables (with -ida)
+  LayoutCache layouts;
+
+  auto worker = [&]() {
+    for (unsigned int f = next_file++; f < files.size(); f = next_file++) {
+      std::string line = solveOne(files[f],options,layouts);
+      std::lock_guard<std::mutex> lock(output_lock);
+      results[f].swap(line);
+      done[f] = true;
+      for (; next_line < files.size() && done[next_line]; next_line++) {
+        ostr << results[next_line] << "\n";
+        results[next_line].clear();
+      }
+      ostr.flush();
+    }
+  };
+  std::vector<std::thread> workers;
+  for (int t = 1; t < options.num_threads; t++)
+    workers.push_back(std::thread(worker));
+  worker();
+  for (unsigned int t = 0; t < workers.size(); t++)
+    workers[t].join();
+}
+
+std::vector<std::string> readManifest(std::istream &istr) {
+  std::vector<std::string> files;
+  std::string line;
+  while (std::getline(istr,line)) {
+    // trim surrounding whitespace (and a \r from DOS line endings)
+    std::string::size_type first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos) continue;
+    std::string::size_type last = line.find_last_not_of(" \t\r");
+    files.push_back(line.substr(first,last-first+1));
+  }
+  return files;
+}
@@ -0,0 +1,46 @@
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "solution_cache.h"
+
+
+// ==================================================================
+// ==================================================================
+// Solving many puzzle files in one process.  num_threads workers each
+// take the next unsolved file, load it and search it (one thread per
+// puzzle), so throughput is bound by the searches rather than by
+// process startup or printing boards.  One line per puzzle is written
+// to ostr, in the order the files were given, as each becomes ready:
+//
+//   puzzle1.txt: 6 moves: A north, A east, C south, ...
+//   puzzle6.txt: no solutions
+//   missing.txt: ERROR could not open missing.txt for reading
+
+class SolveOptions {
+public:
+  SolveOptions() : max_moves(-1), num_threads(1), use_ida(false), symmetry(false), cache(NULL) {}
+  int max_moves;
+  int num_threads;
+  bool use_ida;
+  bool symmetry;
+  // if not NULL, consulted before searching and given every result
+  SolutionCache *cache;
+};
+
+void batch_solve(const std::vector<std::string> &files, const SolveOptions &options, std::ostream &ostr);
+
+// search one loaded puzzle and describe the result the way a batch
+// line does after the file name: "6 moves: A north, ..." or
+// "no solutions" (the search itself is always single threaded)
+std::string solvePuzzle(const Board &board, const SolveOptions &options);
+
+// the puzzle file names listed in a manifest, one per line (blank
+// lines are skipped)
+std::vector<std::string> readManifest(std::istream &istr);
+
+#endif
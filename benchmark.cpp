@@ -0,0 +1,205 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "board.h"
+#include "solver.h"
+#include "puzzle.h"
+#include "stats.h"
+
+// ./benchmark [-iterations N] [-max_moves N] [-threads N] [-max_cells N] [puzzle files...]
+//
+// Times the search drivers behind each mode of the robot program on
+// every puzzle file (by default the shipped puzzle1.txt - puzzle8.txt
+// and puzzle_test.txt), with and without a cap on the moves.  Each
+// case prints one JSON object per line, so two builds can be compared
+// with diff or a script:
+//
+//   {"puzzle":"puzzle1.txt","mode":"one_solution","max_moves":-1,
+//    "result":"6 moves","iterations":5,"p50_ms":...,"p90_ms":...,
+//    "max_ms":...,"expanded":...,"generated":...,"states_per_sec":...,
+//    "peak_rss_kb":...}
+//
+// expanded and generated are per iteration (see SearchCounters).
+// Each case runs in a child process of its own, so peak_rss_kb is the
+// peak of that case alone (plus the small footprint of the benchmark
+// itself at the fork), whatever ran before it.  Exhaustive reachability (visualize with no cap) is only
+// run on boards of at most -max_cells cells (default 64); on the 16x16
+// boards with five robots it does not finish.
+
+// ==================================================================================
+// ==================================================================================
+
+void usage(const std::string &executable_name) {
+  std::cerr << "Usage: " << executable_name << " [-iterations <#>] [-max_moves <#>] [-threads <#>]"
+            << " [-max_cells <#>] [<puzzle_file> ...]" << std::endl;
+  exit(0);
+}
+
+class Settings {
+public:
+  Settings() : iterations(5), max_moves(6), num_threads(1), max_cells(64) {}
+  int iterations;
+  int max_moves;
+  int num_threads;
+  int max_cells;
+};
+
+// run one search of the given mode, returning a short description of
+// the answer (so a change in the results shows up next to the timings)
+std::string runMode(const std::string &mode, const Board &board, int max_moves, const Settings &settings) {
+  std::ostringstream result;
+  if (mode == "one_solution") {
+    std::vector<Move> moves;
+    if (parallel_bfs_solve(board,max_moves,settings.num_threads,moves))
+      result << moves.size() << " moves";
+    else
+      result << "no solutions";
+  } else if (mode == "all_solutions") {
+    // enumerate them too, as -all_solutions does when printing
+    ShortestPathDag dag(board,max_moves);
+    unsigned long long seen = 0;
+    dag.enumerate([&](const std::vector<Move> &) { seen++; });
+    if (dag.solvable())
+      result << seen << " solutions of " << dag.minMoves() << " moves";
+    else
+      result << "no solutions";
+  } else {
+    std::vector<std::vector<int> > visual = reachability(board,0,max_moves);
+    int reached = 0;
+    for (unsigned int r = 0; r < visual.size(); r++)
+      for (unsigned int c = 0; c < visual[r].size(); c++)
+        if (visual[r][c] != -1) reached++;
+    result << reached << " cells reachable by " << board.getRobot(0);
+  }
+  return result.str();
+}
+
+// time one case, returning its JSON object without the peak memory
+// and the closing brace
+std::string measureCase(const std::string &filename, const Board &board, const std::string &mode,
+                        int max_moves, const Settings &settings) {
+  std::vector<double> times;
+  std::string result;
+  search_counters.reset();
+  for (int i = 0; i < settings.iterations; i++) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    result = runMode(mode,board,max_moves,settings);
+    std::chrono::duration<double,std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    times.push_back(elapsed.count());
+  }
+  double total_ms = 0;
+  for (unsigned int i = 0; i < times.size(); i++) total_ms += times[i];
+  std::sort(times.begin(),times.end());
+  unsigned long long expanded = search_counters.expanded;
+  unsigned long long generated = search_counters.generated;
+
+  std::ostringstream line;
+  line << std::fixed << std::setprecision(3)
+       << "{\"puzzle\":\"" << filename << "\",\"mode\":\"" << mode << "\""
+       << ",\"max_moves\":" << max_moves
+       << ",\"result\":\"" << result << "\""
+       << ",\"iterations\":" << settings.iterations
+       << ",\"p50_ms\":" << percentile(times,50)
+       << ",\"p90_ms\":" << percentile(times,90)
+       << ",\"max_ms\":" << times.back()
+       << ",\"expanded\":" << expanded / settings.iterations
+       << ",\"generated\":" << generated / settings.iterations
+       << std::setprecision(0)
+       << ",\"states_per_sec\":" << (total_ms > 0 ? expanded / (total_ms / 1000.0) : 0.0);
+  return line.str();
+}
+
+// measure one case in a forked child, which sends its line back on a
+// pipe; the peak memory is the child's, from wait4
+void runCase(const std::string &filename, const Board &board, const std::string &mode,
+             int max_moves, const Settings &settings) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    std::cerr << "ERROR: could not create a pipe" << std::endl;
+    exit(1);
+  }
+  std::cout.flush();
+  pid_t child = fork();
+  if (child < 0) {
+    std::cerr << "ERROR: could not fork" << std::endl;
+    exit(1);
+  }
+  if (child == 0) {
+    close(fds[0]);
+    std::string line = measureCase(filename,board,mode,max_moves,settings);
+    for (size_t sent = 0; sent < line.size(); ) {
+      ssize_t n = write(fds[1],line.data()+sent,line.size()-sent);
+      if (n <= 0) _exit(1);
+      sent += n;
+    }
+    _exit(0);
+  }
+  close(fds[1]);
+  std::string line;
+  char buffer[4096];
+  for (ssize_t n; (n = read(fds[0],buffer,sizeof(buffer))) > 0; )
+    line.append(buffer,n);
+  close(fds[0]);
+  int status;
+  struct rusage usage;
+  if (wait4(child,&status,0,&usage) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    std::cerr << "ERROR: " << filename << " " << mode << " did not finish" << std::endl;
+    exit(1);
+  }
+  std::cout << line << ",\"peak_rss_kb\":" << usage.ru_maxrss << "}" << std::endl;
+}
+
+// ==================================================================================
+// ==================================================================================
+
+int main(int argc, char* argv[]) {
+  Settings settings;
+  std::vector<std::string> files;
+  for (int arg = 1; arg < argc; arg++) {
+    std::string flag = argv[arg];
+    if (flag == "-iterations" || flag == "-max_moves" || flag == "-threads" || flag == "-max_cells") {
+      arg++;
+      if (arg >= argc) usage(argv[0]);
+      int value = atoi(argv[arg]);
+      if (value <= 0) usage(argv[0]);
+      if (flag == "-iterations") settings.iterations = value;
+      else if (flag == "-max_moves") settings.max_moves = value;
+      else if (flag == "-threads") settings.num_threads = value;
+      else settings.max_cells = value;
+    } else if (flag[0] == '-') {
+      usage(argv[0]);
+    } else {
+      files.push_back(flag);
+    }
+  }
+  if (files.empty()) {
+    for (int i = 1; i <= 8; i++) files.push_back("puzzle" + std::to_string(i) + ".txt");
+    files.push_back("puzzle_test.txt");
+  }
+
+  const char* modes[] = { "one_solution", "all_solutions", "visualize" };
+  for (unsigned int f = 0; f < files.size(); f++) {
+    Board board(1,1);
+    std::string error;
+    if (!readPuzzleFile(files[f],board,error)) {
+      std::cerr << "ERROR: " << error << std::endl;
+      return 1;
+    }
+    for (int m = 0; m < 3; m++) {
+      runCase(files[f],board,modes[m],settings.max_moves,settings);
+      if (modes[m] == std::string("visualize") && board.getRows()*board.getCols() > settings.max_cells)
+        continue;
+      runCase(files[f],board,modes[m],-1,settings);
+    }
+  }
+  return 0;
+}
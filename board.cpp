@@ -1,8 +1,11 @@
 #include <iomanip>
+#include <algorithm>
 #include <cstdlib>
 #include <cmath>
 
 #include "board.h"
+#include "stats.h"
+#include "trace.h"
 
 // ==================================================================
 // ==================================================================
@@ -27,35 +30,57 @@ bool operator!=(const Position &a, const Position &b) {
 
 // ==================================================================
 // ==================================================================
-// Implementation of the Board class
+// Implementation of the StateKey class
+
+
+bool operator==(const StateKey &a, const StateKey &b) {
+  return (a.lo == b.lo && a.hi == b.hi);
+}
+bool operator!=(const StateKey &a, const StateKey &b) {
+  return !(a==b);
+}
+bool operator<(const StateKey &a, const StateKey &b) {
+  return (a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo));
+}
+
+// mix both words so that keys differing in a single robot spread
+// across the whole table (the splitmix64 finalizer)
+size_t StateKeyHash::operator()(const StateKey &k) const {
+  return (size_t)mix64(k.lo ^ (k.hi * 0x9e3779b97f4a7c15ULL));
+}
+
+
+// ==================================================================
+// ==================================================================
+// Implementation of the BoardGeometry class
 
 
 // ===================
 // CONSTRUCTOR
 // ===================
 
-Board::Board(int r, int c) { 
+BoardGeometry::BoardGeometry(int r, int c) { 
   // initialize the dimensions
+  // (each row and column of walls must fit in a 64 bit mask)
+  assert (r < 63 && c < 63);
   rows = r; 
   cols = c; 
 
-  // allocate space for the contents of each grid cell
-  board = std::vector<std::vector<char> >(rows,std::vector<char>(cols,' '));
+  // the bits needed to number every cell in a StateKey
+  cell_bits = 1;
+  while ((1 << cell_bits) < rows*cols) cell_bits++;
+  assert (cell_bits * MAX_ROBOTS <= 128);
 
-  // allocate space for booleans indicating the presense of each wall
-  // by default, these are false == no wall
+  // allocate one bitmask of walls per row and per column
   // (note that there must be an extra column of vertical walls
-  //  and an extra row of horizontal walls)
-  vertical_walls = std::vector<std::vector<bool> >(rows,std::vector<bool>(cols+1,false));
-  horizontal_walls = std::vector<std::vector<bool> >(rows+1,std::vector<bool>(cols,false));
-
+  //  and an extra row of horizontal walls, bits 0 and cols/rows)
   // initialize the outermost edges of the grid to have walls
-  for (int i = 0; i < rows; i++) {
-    vertical_walls[i][0] = vertical_walls[i][cols] = true;
-  }
-  for (int i = 0; i < cols; i++) {
-    horizontal_walls[0][i] = horizontal_walls[rows][i] = true;
-  }
+  vertical_walls = std::vector<uint64_t>(rows,1 | (uint64_t(1) << cols));
+  horizontal_walls = std::vector<uint64_t>(cols,1 | (uint64_t(1) << rows));
+
+  // no goals yet
+  std::fill(robot_goals, robot_goals+MAX_ROBOTS, 0);
+  any_goals = 0;
 }
 
 
@@ -64,25 +89,37 @@ Board::Board(int r, int c) {
 // ===================
 
 // Query the existance of a horizontal wall
-bool Board::getHorizontalWall(double r, int c) const {
+bool BoardGeometry::getHorizontalWall(double r, int c) const {
   // verify that the requested wall is valid
   // the row coordinate must be a half unit
   assert (fabs((r - floor(r))-0.5) < 0.005);
   assert (r >= 0.4 && r <= rows+0.6);
   assert (c >= 1 && c <= cols);
   // subtract one and round down because the corner is (0,0) not (1,1)
-  return horizontal_walls[floor(r)][c-1];
+  return (horizontal_walls[c-1] >> (int)floor(r)) & 1;
 }
 
 // Query the existance of a vertical wall
-bool Board::getVerticalWall(int r, double c) const {
+bool BoardGeometry::getVerticalWall(int r, double c) const {
   // verify that the requested wall is valid
   // the column coordinate must be a half unit
   assert (fabs((c - floor(c))-0.5) < 0.005);
   assert (r >= 1 && r <= rows);
   assert (c >= 0.4 && c <= cols+0.6);
   // subtract one and round down because the corner is (0,0) not (1,1)
-  return vertical_walls[r-1][floor(c)];
+  return (vertical_walls[r-1] >> (int)floor(c)) & 1;
+}
+
+char BoardGeometry::isGoal(const Position &p) const {
+  // verify that the requested coordinate is valid
+  assert (p.row >= 1 && p.row <= rows);
+  assert (p.col >= 1 && p.col <= cols);
+  // loop over the goals, see if any match this spot
+  for (unsigned int i = 0; i < goals.size(); i++) {
+    if (p == goals[i].pos) { return goals[i].which; }
+  }
+  // else return space indicating that no goal is at this location
+  return ' ';
 }
 
 
@@ -91,97 +128,252 @@ bool Board::getVerticalWall(int r, double c) const {
 // ===================
 
 // Add an interior horizontal wall
-void Board::addHorizontalWall(double r, int c) {
+void BoardGeometry::addHorizontalWall(double r, int c) {
   // verify that the requested wall is valid
   // the row coordinate must be a half unit
   assert (fabs((r - floor(r))-0.5) < 0.005);
   assert (r >= 0 && r <= rows);
   assert (c >= 1 && c <= cols);
   // verify that the wall does not already exist
-  assert (horizontal_walls[floor(r)][c-1] == false);
+  assert (getHorizontalWall(r,c) == false);
   // subtract one and round down because the corner is (0,0) not (1,1)
-  horizontal_walls[floor(r)][c-1] = true;
+  horizontal_walls[c-1] |= uint64_t(1) << (int)floor(r);
 }
 
 // Add an interior vertical wall
-void Board::addVerticalWall(int r, double c) {
+void BoardGeometry::addVerticalWall(int r, double c) {
   // verify that the requested wall is valid
   // the column coordinate must be a half unit
   assert (fabs((c - floor(c))-0.5) < 0.005);
   assert (r >= 1 && r <= rows);
   assert (c >= 0 && c <= cols);
   // verify that the wall does not already exist
-  assert (vertical_walls[r-1][floor(c)] == false);
+  assert (getVerticalWall(r,c) == false);
   // subtract one and round down because the corner is (0,0) not (1,1)
-  vertical_walls[r-1][floor(c)] = true;
+  vertical_walls[r-1] |= uint64_t(1) << (int)floor(c);
+}
+
+// Add a goal (the robot label has already been validated, and turned
+// into robot_index, by the Board)
+void BoardGeometry::addGoal(char goal_robot, int robot_index, const Position &p) {
+  // check that input data is reasonable
+  assert (p.row >= 1 && p.row <= rows);
+  assert (p.col >= 1 && p.col <= cols);
+  // make sure we don't already have a goal at that location
+  assert (isGoal(p) == ' ');
+  // index the goal for the success test
+  int k = goals.size();
+  assert (k < 64);
+  goal_robots.push_back(robot_index);
+  if (robot_index == -1)
+    any_goals |= uint64_t(1) << k;
+  else
+    robot_goals[robot_index] |= uint64_t(1) << k;
+  // add this goal label and position to the vector of goals
+  goals.push_back(Goal(p,goal_robot));
+}
+
+// Precompute (or find in the cache) the tables that depend only on
+// the walls
+void BoardGeometry::buildLayoutTables(LayoutCache *cache) {
+  TraceSpan span("preprocess");
+  if (cache != NULL)
+    layout = cache->lookup(rows,cols,vertical_walls,horizontal_walls);
+  else
+    layout.reset(new LayoutTables(rows,cols,vertical_walls,horizontal_walls));
+}
+
+
+// ==================================================================
+// ==================================================================
+// Implementation of the Board class
+
+
+// ===================
+// CONSTRUCTOR
+// ===================
+
+Board::Board(int r, int c) : geometry(new BoardGeometry(r,c)) {
 }
 
 
 // ===================
-// PRIVATE HELPER FUNCTIONS related to board geometry
+// MODIFIERS related to board geometry
 // ===================
 
-char Board::getspot(const Position &p) const {
-  // verify that the requested coordinate is valid
-  assert (p.row >= 1 && p.row <= rows);
-  assert (p.col >= 1 && p.col <= cols);
-  // subtract one from each coordinate because the corner is (0,0) not (1,1)
-  return board[p.row-1][p.col-1];
+// the geometry may only change while this board is its sole owner,
+// i.e. while the puzzle is still being loaded
+void Board::addHorizontalWall(double r, int c) {
+  assert (geometry.use_count() == 1);
+  geometry->addHorizontalWall(r,c);
 }
 
+void Board::addVerticalWall(int r, double c) {
+  assert (geometry.use_count() == 1);
+  geometry->addVerticalWall(r,c);
+}
 
-void Board::setspot(const Position &p, char a) {
-  // verify that the requested coordinate is valid
-  assert (p.row >= 1 && p.row <=  rows);
-  assert (p.col >= 1 && p.col <= cols);
-  // subtract one from each coordinate because the corner is (0,0) not (1,1)
-  board[p.row-1][p.col-1] = a;
+void Board::buildLayoutTables(LayoutCache *cache) {
+  assert (geometry.use_count() == 1);
+  geometry->buildLayoutTables(cache);
 }
 
-char Board::isGoal(const Position &p) const {
+
+// ===================
+// ACCESSORS related to robots
+// ===================
+
+// the label of the robot at this location, or a space if it is empty
+char Board::getspot(const Position &p) const {
   // verify that the requested coordinate is valid
-  assert (p.row >= 1 && p.row <= rows);
-  assert (p.col >= 1 && p.col <= cols);
-  // loop over the goals, see if any match this spot
-  for (unsigned int i = 0; i < goals.size(); i++) {
-    if (p == goals[i].pos) { return goals[i].which; }
+  assert (p.row >= 1 && p.row <= getRows());
+  assert (p.col >= 1 && p.col <= getCols());
+  for (int i = 0; i < state.count; i++) {
+    if (state.robots[i].pos == p) { return state.robots[i].which; }
   }
-  // else return space indicating that no goal is at this location
   return ' ';
 }
 
 
+// a robot goal needs that robot on its cell, an "any" goal needs
+// someone there
+bool Board::isSolved() const {
+  for (unsigned int k = 0; k < geometry->numGoals(); k++) {
+    Position g = geometry->getGoalPosition(k);
+    int robot = geometry->getGoalRobotIndex(k);
+    if (robot >= 0) {
+      if (state.robots[robot].pos != g) return false;
+    } else if (((rowRobots(g.row) >> g.col) & 1) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
 
-// ===================
-// ACCESSORS related to robots
-// ===================
+// if the board was not solved a move ago, only the robot that moved
+// can have finished it, by stopping on one of its goals
+bool Board::isSolved(int moved) const {
+  const Position &p = state.robots[moved].pos;
+  for (uint64_t mask = geometry->getRobotGoals(moved); mask != 0; mask &= mask-1) {
+    if (geometry->getGoalPosition(__builtin_ctzll(mask)) == p)
+      return isSolved();
+  }
+  return false;
+}
+
+
+// pack the robot positions into a key, robot i in bits [i*b, (i+1)*b)
+StateKey Board::packState() const {
+  uint64_t cells[MAX_ROBOTS];
+  for (int i = 0; i < state.count; i++)
+    cells[i] = geometry->cellIndex(state.robots[i].pos);
+  return packCells(cells);
+}
+
+StateKey Board::packCanonicalState() const {
+  uint64_t cells[MAX_ROBOTS];
+  int slots[MAX_ROBOTS];
+  int n = 0;
+  for (int i = 0; i < state.count; i++) {
+    cells[i] = geometry->cellIndex(state.robots[i].pos);
+    if (geometry->getRobotGoals(i) == geometry->getAnyGoals()) slots[n++] = i;
+  }
+  // insertion sort the interchangeable robots' cells among their slots
+  for (int a = 1; a < n; a++) {
+    for (int b = a; b > 0 && cells[slots[b-1]] > cells[slots[b]]; b--)
+      std::swap(cells[slots[b-1]],cells[slots[b]]);
+  }
+  return packCells(cells);
+}
+
+StateKey Board::packCells(const uint64_t *cells) const {
+  StateKey key;
+  int bits = geometry->getCellBits();
+  for (int i = 0; i < state.count; i++) {
+    uint64_t cell = cells[i];
+    int offset = i*bits;
+    if (offset < 64) {
+      key.lo |= cell << offset;
+      if (offset + bits > 64) key.hi |= cell >> (64 - offset);
+    } else {
+      key.hi |= cell << (offset - 64);
+    }
+  }
+  return key;
+}
 
 
 // ===================
 // MODIFIERS related to robots
 // ===================
 
+// the inverse of packState
+void Board::unpackState(const StateKey &key) {
+  int bits = geometry->getCellBits();
+  uint64_t mask = (uint64_t(1) << bits) - 1;
+  for (int i = 0; i < state.count; i++) {
+    int offset = i*bits;
+    uint64_t cell;
+    if (offset < 64) {
+      cell = key.lo >> offset;
+      if (offset + bits > 64) cell |= key.hi << (64 - offset);
+    } else {
+      cell = key.hi >> (offset - 64);
+    }
+    state.robots[i] = Robot(geometry->cellPosition(cell & mask), state.robots[i].which);
+  }
+}
+
+// the robot bitmasks are rebuilt from state each time rather than
+// stored, so a Board stays small to copy (there are at most
+// MAX_ROBOTS robots to look at)
+uint64_t Board::rowRobots(int r) const {
+  uint64_t mask = 0;
+  for (int i = 0; i < state.count; i++) {
+    if (state.robots[i].pos.row == r) mask |= uint64_t(1) << state.robots[i].pos.col;
+  }
+  return mask;
+}
+
+uint64_t Board::colRobots(int c) const {
+  uint64_t mask = 0;
+  for (int i = 0; i < state.count; i++) {
+    if (state.robots[i].pos.col == c) mask |= uint64_t(1) << state.robots[i].pos.row;
+  }
+  return mask;
+}
+
+uint64_t Board::occupiedRows() const {
+  uint64_t mask = 0;
+  for (int i = 0; i < state.count; i++) mask |= uint64_t(1) << state.robots[i].pos.row;
+  return mask;
+}
+
+uint64_t Board::occupiedCols() const {
+  uint64_t mask = 0;
+  for (int i = 0; i < state.count; i++) mask |= uint64_t(1) << state.robots[i].pos.col;
+  return mask;
+}
+
 // for initial placement of a new robot
 void Board::placeRobot(const Position &p, char a) {
 
   // check that input data is reasonable
-  assert (p.row >= 1 && p.row <= rows);
-  assert (p.col >= 1 && p.col <= cols);
+  assert (p.row >= 1 && p.row <= getRows());
+  assert (p.col >= 1 && p.col <= getCols());
   assert (getspot(p) == ' ');
+  assert (state.count < MAX_ROBOTS);
   
   // robots must be represented by a capital letter
   assert (isalpha(a) && isupper(a));
 
   // make sure we don't already have a robot with the same name
-  for (unsigned int i = 0; i < robots.size(); i++) {
-    assert (robots[i].which != a);
+  for (int i = 0; i < state.count; i++) {
+    assert (state.robots[i].which != a);
   }
 
-  // add the robot and its position to the vector of robots
-  robots.push_back(Robot(p,a));
-
-  // mark the robot on the board
-  setspot(p,a);
+  // add the robot and its position to the robot state
+  state.robots[state.count++] = Robot(p,a);
 }
 
 //======================================================
@@ -195,219 +387,188 @@ void Board::placeRobot(const Position &p, char a) {
 //north, east, south, and west: all bools that record the 
 //most recent direction travelled.
 bool Board::checkLR(const int &i) {
-	if (robots[i].west == true) {
-		if (robots[i].east == true) 
+	if (state.robots[i].west == true) {
+		if (state.robots[i].east == true) {
+			STAT(search_stats.prune(SearchStats::PRUNE_LR));
 			return false;
+		}
 	}
 	return true;
 }
 
 bool Board::checkLeft(const int &i) {
-	if( robots[i].east == true) {
-		for (int x = 0; x < robots.size(); ++x) {
-			if (getRobotPosition(x).col < getRobotPosition(i).col)
-				return true;
-		}
-		return false;
+	if (state.robots[i].east == true) {
+		// is any robot in a column to the left?
+		bool useful = (occupiedCols() & ((uint64_t(1) << getRobotPosition(i).col) - 1)) != 0;
+		if (!useful)
+			STAT(search_stats.prune(SearchStats::PRUNE_LEFT));
+		return useful;
 	}
 	return true;
 }
 bool Board::checkRight(const int &i) {
-	if (robots[i].west == true) {
-		for (int x = 0; x < robots.size(); ++x) {
-			if (getRobotPosition(x).col > getRobotPosition(i).col)
-				return true;
-		}
-		return false;
+	if (state.robots[i].west == true) {
+		// is any robot in a column to the right?
+		bool useful = (occupiedCols() & (~uint64_t(0) << (getRobotPosition(i).col + 1))) != 0;
+		if (!useful)
+			STAT(search_stats.prune(SearchStats::PRUNE_RIGHT));
+		return useful;
 	}
 	return true;
-	
 }
 bool Board::checkUp(const int &i) {
-	if (robots[i].south == true) {
-		for (int x = 0; x < robots.size(); ++x) {
-			if (getRobotPosition(x).row < getRobotPosition(i).row)
-				return true;
-		}
-		return false;
+	if (state.robots[i].south == true) {
+		// is any robot in a row above?
+		bool useful = (occupiedRows() & ((uint64_t(1) << getRobotPosition(i).row) - 1)) != 0;
+		if (!useful)
+			STAT(search_stats.prune(SearchStats::PRUNE_UP));
+		return useful;
 	}
 	return true;
 }
 bool Board::checkDown(const int &i) {
-	if( robots[i].north == true) {
-		for (int x = 0; x < robots.size(); ++x) {
-			if (getRobotPosition(x).row > getRobotPosition(i).row)
-				return true;
-		}
-		return false;
+	if (state.robots[i].north == true) {
+		// is any robot in a row below?
+		bool useful = (occupiedRows() & (~uint64_t(0) << (getRobotPosition(i).row + 1))) != 0;
+		if (!useful)
+			STAT(search_stats.prune(SearchStats::PRUNE_DOWN));
+		return useful;
 	}
 	return true;
 }
 
 bool Board::checkUD(const int &i) {
-	if (robots[i].north == true) {
-		if (robots[i].south == true) 
+	if (state.robots[i].north == true) {
+		if (state.robots[i].south == true) {
+			STAT(search_stats.prune(SearchStats::PRUNE_UD));
 			return false;
+		}
 	}
 	return true;
 }
 
 
+// the direction named on the command line or in a puzzle file
+Direction directionFromString(const std::string &direction) {
+  if (direction == "up") return UP;
+  if (direction == "down") return DOWN;
+  if (direction == "left") return LEFT;
+  assert (direction == "right");
+  return RIGHT;
+}
+
+// record the most recent direction travelled by a robot (these flags
+// are used by the check[blah] oscillation filters above)
+template <Direction D>
+void Board::markDirection(int i) {
+  Robot &r = state.robots[i];
+  if (D == UP) {
+    r.north = true;
+    r.east = false;
+    r.west = false;
+  } else if (D == DOWN) {
+    if (r.north == true)
+      r.south = true;
+    r.east = false;
+    r.west = false;
+  } else if (D == LEFT) {
+    if (r.east == true)
+      r.south = false;
+    else
+      r.east = false;
+    r.west = true;
+    r.north = false;
+  } else {
+    if (r.west == true)
+      r.south = false;
+    else
+      r.west = false;
+    r.east = true;
+    r.north = false;
+  }
+}
+
+// where robot i would come to rest sliding in direction D, found with
+// a single bit scan of the walls and robots in its row or column.  D is
+// a template argument so each direction compiles to straight line code.
+template <Direction D>
+Position Board::slide(int i) const {
+  const bool vertical = (D == UP || D == DOWN);
+  Position p = state.robots[i].pos;
+  // every robot sharing this row or column (our own bit is harmless,
+  // the slide helpers only look past the starting index)
+  uint64_t blockers = vertical ? colRobots(p.col) : rowRobots(p.row);
+  if (D == UP)
+    return Position(slideToLow(geometry->getColWalls(p.col),blockers,p.row),p.col);
+  if (D == DOWN)
+    return Position(slideToHigh(geometry->getColWalls(p.col),blockers,p.row),p.col);
+  if (D == LEFT)
+    return Position(p.row,slideToLow(geometry->getRowWalls(p.row),blockers,p.col));
+  return Position(p.row,slideToHigh(geometry->getRowWalls(p.row),blockers,p.col));
+}
+
+template <Direction D>
+bool Board::moveKernel(int i) {
+  Position stop = slide<D>(i);
+  if (stop == state.robots[i].pos)
+    return false;
+  STAT(search_stats.slide(abs(stop.row-state.robots[i].pos.row) + abs(stop.col-state.robots[i].pos.col)));
+  markDirection<D>(i);
+  state.robots[i].pos = stop;
+  return true;
+}
+
+// slide a robot until it hits a wall or another robot.  returns false
+// if the robot could not move at all.
+bool Board::moveRobot(int i, Direction dir) {
+  assert (i >= 0 && i < state.count);
+  switch (dir) {
+    case UP:    return moveKernel<UP>(i);
+    case DOWN:  return moveKernel<DOWN>(i);
+    case LEFT:  return moveKernel<LEFT>(i);
+    default:    return moveKernel<RIGHT>(i);
+  }
+}
+
 bool Board::moveRobot(int i, const std::string &direction) {
-	float robot_row = getRobotPosition(i).row;
-	float robot_col = getRobotPosition(i).col;
-	if (direction == "up") {
-		// if we hit a wall, don't move
-		if (getHorizontalWall(robot_row - .5, getRobotPosition(i).col)) 
-			return false;
-		// otherwise, until we hit a wall....
-		while (!getHorizontalWall(getRobotPosition(i).row - .5, robot_col)) {
-			// check to see if we'll hit a robot
-			for (int x = 0; x < robots.size(); ++x) {
-				if (getRobotPosition(x) == Position(getRobotPosition(i).row - 1, getRobotPosition(i).col) && x != i)
-					return false;
-			}
-			// if we don't, move the robot 
-			if (robots[i].south == true) {
-				robots[i].north = true;
-				robots[i].east = false; 
-				robots[i].west = false;
-			}
-			else {
-				robots[i].south == false;
-				robots[i].north = true;
-				robots[i].east = false; 
-				robots[i].west = false;
-			}
-			setspot(getRobotPosition(i), ' ');
-			robots[i].pos = Position(getRobotPosition(i).row - 1, getRobotPosition(i).col);
-			setspot(getRobotPosition(i), getRobot(i));
-		}
-		return true;
-	}
-	
-	if (direction == "left") {
-		if (getVerticalWall(robot_row, robot_col - .5)) 
-			return false;
-		while (!getVerticalWall(getRobotPosition(i).row, getRobotPosition(i).col - .5)) {
-			for (int x = 0; x < robots.size(); ++x) {
-				if (getRobotPosition(x) == Position(getRobotPosition(i).row, getRobotPosition(i).col - 1) && x != i)
-					return false;
-			}
-			if (robots[i].east == true) {
-				robots[i].west = true;
-				robots[i].south = false; 
-				robots[i].north = false;
-			}
-			
-			else {
-				robots[i].south == false;
-				robots[i].west = true;
-				robots[i].east = false; 
-				robots[i].north = false;
-			}
-			setspot(getRobotPosition(i), ' ');
-			robots[i].pos = Position(getRobotPosition(i).row, getRobotPosition(i).col - 1);
-			setspot(getRobotPosition(i), getRobot(i));
-		}
-		return true;
-	}
-	
-	if (direction == "right") {
-		if (getVerticalWall(robot_row, robot_col + .5)) 
-			return false;
-		while (!getVerticalWall(getRobotPosition(i).row, getRobotPosition(i).col + .5)) {
-			for (int x = 0; x < robots.size(); ++x) {
-				if (getRobotPosition(x) == Position(getRobotPosition(i).row, getRobotPosition(i).col + 1) && x != i)
-					return false;
-			}
-			if (robots[i].west == true) {
-				robots[i].north = false;
-				robots[i].east = true; 
-				robots[i].south = false;
-			}
-			else {
-				robots[i].south == false;
-				robots[i].north = false;
-				robots[i].east = true; 
-				robots[i].west = false;
-			}
-			setspot(getRobotPosition(i), ' ');
-			robots[i].pos = Position(getRobotPosition(i).row, getRobotPosition(i).col + 1);
-			setspot(getRobotPosition(i), getRobot(i));
-		}
-		return true;
-	}
-	
-	if (direction == "down") {
-		if (getHorizontalWall(robot_row + .5, robot_col)) 
-			return false;
-		while (!getHorizontalWall(getRobotPosition(i).row + .5, getRobotPosition(i).col)) {
-			for (int x = 0; x < robots.size(); ++x) {
-				if (getRobotPosition(x) == Position(getRobotPosition(i).row + 1, getRobotPosition(i).col) && x != i)
-					return false;
-			}
-			if (robots[i].north == true) {
-				robots[i].south = true;
-				robots[i].east = false; 
-				robots[i].west = false;
-			}
-			else {
-				robots[i].south == true;
-				robots[i].north = false;
-				robots[i].east = false; 
-				robots[i].west = false;
-			}
-			setspot(getRobotPosition(i), ' ');
-			robots[i].pos = Position(getRobotPosition(i).row + 1, getRobotPosition(i).col);
-			setspot(getRobotPosition(i), getRobot(i));
-		}
-		return true;
-	}	
+  return moveRobot(i, directionFromString(direction));
+}
+
+UndoToken Board::applyMove(int i, Direction dir) {
+  Robot previous = state.robots[i];
+  bool moved = moveRobot(i, dir);
+  return UndoToken(i, previous, moved);
+}
+
+UndoToken Board::applyMove(int i, const std::string &direction) {
+  return applyMove(i, directionFromString(direction));
+}
+
+void Board::undoMove(const UndoToken &token) {
+  state.robots[token.robot] = token.previous;
 }
 
 // a function that makes extra sure a robot is capable of moving before we try to. 
-// uses less checks than moveRobot.
-bool Board::checkmove(const int &i, const std::string &direction) {
-	float robot_row = getRobotPosition(i).row;
-	float robot_col = getRobotPosition(i).col;
+// a robot can move if the first cell in that direction is neither
+// behind a wall nor occupied.
+bool Board::checkmove(int i, Direction dir) const {
+  Position p = state.robots[i].pos;
+  Position stop;
+  switch (dir) {
+    case UP:    stop = slide<UP>(i); break;
+    case DOWN:  stop = slide<DOWN>(i); break;
+    case LEFT:  stop = slide<LEFT>(i); break;
+    default:    stop = slide<RIGHT>(i); break;
+  }
+  if (stop == p) {
+    STAT(search_stats.checkmoveRejected());
+    return false;
+  }
+  return true;
+}
 
-	if (direction == "up") {
-		if (getHorizontalWall(robot_row -.5, robot_col)) 
-			return false;
-		for (int x = 0; x < robots.size(); ++x) {
-			if (getRobotPosition(x) == Position(getRobotPosition(i).row - 1, getRobotPosition(i).col) && x != i)
-				return false;
-		}
-	}
-	
-	if (direction == "down") {
-		if (getHorizontalWall(robot_row + .5, robot_col))
-			return false;
-		for (int x = 0; x < robots.size(); ++x) {
-			if (getRobotPosition(x) == Position(getRobotPosition(i).row + 1, getRobotPosition(i).col) && x != i)
-				return false;
-		}
-	}
-	
-	if (direction == "left") {
-		if (getVerticalWall(robot_row, robot_col - .5)) 
-			return false;
-		for (int x = 0; x < robots.size(); ++x) {
-			if (getRobotPosition(x) == Position(getRobotPosition(i).row, getRobotPosition(i).col - 1) && x != i)
-				return false;
-		}
-	}
-	
-	if (direction == "right") {
-		if (getVerticalWall(robot_row, robot_col + .5)) 
-			return false;
-		for (int x = 0; x < robots.size(); ++x) {
-			if (getRobotPosition(x) == Position(getRobotPosition(i).row, getRobotPosition(i).col + 1) && x != i)
-				return false;
-		}
-	}
-	return true;
+bool Board::checkmove(const int &i, const std::string &direction) {
+  return checkmove(i, directionFromString(direction));
 }
 
 // ===================
@@ -416,10 +577,6 @@ bool Board::checkmove(const int &i, const std::string &direction) {
 
 void Board::addGoal(const std::string &gr, const Position &p) {
 
-  // check that input data is reasonable
-  assert (p.row >= 1 && p.row <= rows);
-  assert (p.col >= 1 && p.col <= cols);
-
   char goal_robot;
   if (gr == "any") {
     goal_robot = '?';
@@ -430,20 +587,18 @@ void Board::addGoal(const std::string &gr, const Position &p) {
   }
 
   // verify that a robot of this name exists for this puzzle
+  int robot_index = -1;
   if (goal_robot != '?') {
-    int robot_exists = false;
-    for (unsigned int i = 0; i < robots.size(); i++) {
+    for (int i = 0; i < state.count; i++) {
       if (getRobot(i) == goal_robot) 
-        robot_exists = true;
+        robot_index = i;
     }
-    assert (robot_exists);
+    assert (robot_index != -1);
   }
-  
-  // make sure we don't already have a robot at that location
-  assert (isGoal(p) == ' ');
 
-  // add this goal label and position to the vector of goals
-  goals.push_back(Goal(p,goal_robot));
+  // add this goal label and position to the shared geometry
+  assert (geometry.use_count() == 1);
+  geometry->addGoal(goal_robot,robot_index,p);
 }
 
 
@@ -452,16 +607,17 @@ void Board::addGoal(const std::string &gr, const Position &p) {
 // ==================================================================
 
 void Board::print() {
+  TraceSpan span("print");
 
   // print the column headings
   std::cout << " ";
-  for (int j = 1; j <= cols; j++) {
+  for (int j = 1; j <= getCols(); j++) {
     std::cout << std::setw(5) << j;
   }
   std::cout << "\n";
   
   // for each row
-  for (int i = 0; i <= rows; i++) {
+  for (int i = 0; i <= getRows(); i++) {
 
     // don't print row 0 (it doesnt exist, the first real row is row 1)
     if (i > 0) {
@@ -473,14 +629,14 @@ void Board::print() {
       // goals are always lowercase (or '?' for any).
       std::string first = "  ";
       std::string middle;
-      for (int j = 0; j <= cols; j++) {
+      for (int j = 0; j <= getCols(); j++) {
 
         if (j > 0) { 
           // determine if a robot is current located in this cell
           // and/or if this is the goal
           Position p(i,j);
           char c = getspot(p);
-          char g = isGoal(p);
+          char g = geometry->isGoal(p);
           if (g != '?') g = tolower(g);
           first += "    ";
           middle += " "; 
@@ -507,7 +663,7 @@ void Board::print() {
 
     // print the horizontal walls between rows
     std::cout << "  +";
-    for (double j = 1; j <= cols; j++) {
+    for (double j = 1; j <= getCols(); j++) {
       (getHorizontalWall(i+0.5,j)) ? std::cout << "----" : std::cout << "    ";
       std::cout << "+";
     }
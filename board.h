@@ -1,7 +1,14 @@
+#ifndef _BOARD_H_
+#define _BOARD_H_
+
 #include <iostream>
 #include <cassert>
 #include <vector>
 #include <string>
+#include <stdint.h>
+#include <memory>
+
+#include "layout.h"
 
 
 // ==================================================================
@@ -28,7 +35,9 @@ bool operator!=(const Position &a, const Position &b);
 
 class Robot {
 public:
-  Robot(Position p, char w) : pos(p), which(w) { 
+  Robot() : which(' '), north(false), south(false), east(false), west(false) {}
+  Robot(Position p, char w) : pos(p), which(w),
+    north(false), south(false), east(false), west(false) {
     assert (isalpha(w) && isupper(w)); }
   Position pos;
   char which;
@@ -55,12 +64,180 @@ public:
 };
 
 
+// ==================================================================
+// ==================================================================
+// The most robots a puzzle may have.  This keeps the robot state a
+// small fixed size value, so copying it never touches the heap.
+// readPuzzle reports a puzzle with more as an error.
+
+const int MAX_ROBOTS = 8;
+
+
+// ==================================================================
+// ==================================================================
+// A tiny all-public helper class holding a canonical packed encoding
+// of where every robot is: robot i's cell index is stored in bits
+// [i*b, (i+1)*b) where b is just enough bits to number every cell.
+// For boards up to 16x16 with 8 robots only the low word is used;
+// larger boards spill into the high word.  Keys are the currency of
+// the solvers' visited sets, caches and parent links.
+
+class StateKey {
+public:
+  StateKey(uint64_t l=0, uint64_t h=0) : lo(l), hi(h) {}
+  uint64_t lo, hi;
+};
+
+bool operator==(const StateKey &a, const StateKey &b);
+bool operator!=(const StateKey &a, const StateKey &b);
+bool operator<(const StateKey &a, const StateKey &b);
+
+// a hash functor so keys can be used in the unordered containers
+class StateKeyHash {
+public:
+  size_t operator()(const StateKey &k) const;
+};
+
+// the splitmix64 finalizer, which spreads every bit of x over the whole
+// result.  the key hash and the puzzle and wall layout fingerprints
+// are all built on it.
+inline uint64_t mix64(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+
+// ==================================================================
+// ==================================================================
+// A class to hold the parts of a puzzle that never change while it
+// is being solved: the dimensions, the location of all walls, the
+// goals, and the tables precomputed from them.  One geometry object
+// is built by load() and then shared (read only) by every copy of
+// the Board made during a search.
+
+class BoardGeometry {
+public:
+
+  // CONSTRUCTOR
+  BoardGeometry(int num_rows, int num_cols);
+
+  // ACCESSORS related the board geometry
+  int getRows() const { return rows; }
+  int getCols() const { return cols; }
+  bool getHorizontalWall(double r, int c) const;
+  bool getVerticalWall(int r, double c) const;
+  // the packed walls of one row (bit k is the wall at column k+0.5)
+  // or of one column (bit k is the wall at row k+0.5)
+  uint64_t getRowWalls(int r) const { return vertical_walls[r-1]; }
+  uint64_t getColWalls(int c) const { return horizontal_walls[c-1]; }
+
+  // ACCESSORS related to the overall puzzle goals
+  unsigned int numGoals() const { return goals.size(); }
+  char getGoalRobot(int i) const { assert (i >= 0 && i < (int)numGoals()); return goals[i].which; }
+  Position getGoalPosition(int i) const { assert (i >= 0 && i < (int)numGoals()); return goals[i].pos; }
+  char isGoal(const Position &p) const;
+  // the goals indexed for the success test: the index of the robot
+  // goal k requires (-1 for an "any" goal), the bitmask of the "any"
+  // goals, and the bitmask of the goals robot i may satisfy
+  int getGoalRobotIndex(int k) const { return goal_robots[k]; }
+  uint64_t getAnyGoals() const { return any_goals; }
+  uint64_t getRobotGoals(int i) const { return robot_goals[i] | any_goals; }
+
+  // ACCESSORS related to cell numbering and the layout tables
+  int numCells() const { return rows*cols; }
+  int cellIndex(const Position &p) const { return (p.row-1)*cols + (p.col-1); }
+  Position cellPosition(int cell) const { return Position(cell/cols+1, cell%cols+1); }
+  const LayoutTables& getLayout() const { assert (layout); return *layout; }
+  // the number of bits each robot takes in a StateKey
+  int getCellBits() const { return cell_bits; }
+
+  // MODIFIERS, only used while the puzzle is loaded
+  void addHorizontalWall(double r, int c);
+  void addVerticalWall(int r, double c);
+  void addGoal(char goal_robot, int robot_index, const Position &p);
+  // (puzzles loaded with the same cache share the tables of any
+  //  identical wall layout)
+  void buildLayoutTables(LayoutCache *cache = NULL);
+
+private:
+
+  // REPRESENTATION
+
+  // the board dimensions
+  int rows;
+  int cols;
+  int cell_bits;
+
+  // the walls packed as bitmasks, one word per row and one per column.
+  // bit k of vertical_walls[r-1] is the wall at column k+0.5 of row r,
+  // bit k of horizontal_walls[c-1] is the wall at row k+0.5 of column c
+  std::vector<uint64_t> vertical_walls;
+  std::vector<uint64_t> horizontal_walls;
+
+  // the distance maps of this wall layout, possibly
+  // shared with other puzzles through a LayoutCache
+  std::shared_ptr<const LayoutTables> layout;
+
+  // the goal positions & the robots that must reach them
+  std::vector<Goal> goals;
+  // the same goals as indexes and bitmasks (robot_goals only holds
+  // the goals naming each robot, the "any" goals are in any_goals)
+  std::vector<int> goal_robots;
+  uint64_t robot_goals[MAX_ROBOTS];
+  uint64_t any_goals;
+};
+
+
+// ==================================================================
+// ==================================================================
+// A tiny all-public helper class holding everything about a puzzle
+// that changes from move to move: the robots, their positions and
+// their most recent directions of travel.
+
+class RobotState {
+public:
+  RobotState() : count(0) {}
+  int count;
+  Robot robots[MAX_ROBOTS];
+};
+
+
+// ==================================================================
+// ==================================================================
+// The four ways a robot can slide, in the order the solvers try them
+// (and as numbered in a Move).
+
+enum Direction { UP = 0, DOWN = 1, LEFT = 2, RIGHT = 3 };
+
+// "up", "down", "left" or "right"
+Direction directionFromString(const std::string &direction);
+
+
+// ==================================================================
+// ==================================================================
+// A tiny all-public helper class returned by Board::applyMove.  It
+// remembers the moved robot as it was before the move, which is all
+// Board::undoMove needs to put the board back.
+
+class UndoToken {
+public:
+  UndoToken(int i, const Robot &r, bool m) : robot(i), previous(r), moved(m) {}
+  int robot;
+  Robot previous;
+  // false if the robot could not move at all
+  bool moved;
+};
+
+
 // ==================================================================
 // ==================================================================
 // A class to hold information about the puzzle board including the
 // dimensions, the location of all walls, the current position of all
 // robots, the goal location, and the robot (if specified) that must
-// reach that position
+// reach that position.  The unchanging parts live in a shared
+// BoardGeometry, so copying a Board only copies the geometry pointer
+// and the robot state.
 
 class Board {
 public:
@@ -69,37 +246,65 @@ public:
   Board(int num_rows, int num_cols);
 
   // ACCESSORS related the board geometry
-  int getRows() const { return rows; }
-  int getCols() const { return cols; }
-  bool getHorizontalWall(double r, int c) const;
-  bool getVerticalWall(int r, double c) const;
+  int getRows() const { return geometry->getRows(); }
+  int getCols() const { return geometry->getCols(); }
+  bool getHorizontalWall(double r, int c) const { return geometry->getHorizontalWall(r,c); }
+  bool getVerticalWall(int r, double c) const { return geometry->getVerticalWall(r,c); }
+  const BoardGeometry& getGeometry() const { return *geometry; }
 
   // ACCESSORS related to the robots and their current positions
-  unsigned int numRobots() const { return robots.size(); }
-  char getRobot(int i) const { assert (i >= 0 && i < (int)numRobots()); return robots[i].which; }
-  Position getRobotPosition(int i) const { assert (i >= 0 && i < (int)numRobots()); return robots[i].pos; }
-  Robot getBotIndex(int i) const {assert (i >= 0 && i < (int)numRobots()); return robots[i]; }
+  unsigned int numRobots() const { return state.count; }
+  char getRobot(int i) const { assert (i >= 0 && i < (int)numRobots()); return state.robots[i].which; }
+  Position getRobotPosition(int i) const { assert (i >= 0 && i < (int)numRobots()); return state.robots[i].pos; }
+  Robot getBotIndex(int i) const {assert (i >= 0 && i < (int)numRobots()); return state.robots[i]; }
+  const RobotState& getState() const { return state; }
+  // the packed key of the current robot positions
+  StateKey packState() const;
+  // the same, but with the robots no goal names (which are
+  // interchangeable, every goal being "any" for them) listed in cell
+  // order, so boards that differ only by swapping those robots share
+  // one key.  unpacking it may put those robots' labels in new places.
+  StateKey packCanonicalState() const;
   
   // ACCESSORS related to the overall puzzle goals
-  unsigned int numGoals() const { return goals.size(); }
+  unsigned int numGoals() const { return geometry->numGoals(); }
   // (if any robot is allowed to reach the goal, this value is '?')
-  char getGoalRobot(int i) const { assert (i >= 0 && i < (int)numGoals()); return goals[i].which; }
-  Position getGoalPosition(int i) const { assert (i >= 0 && i < (int)numGoals()); return goals[i].pos; }
+  char getGoalRobot(int i) const { return geometry->getGoalRobot(i); }
+  Position getGoalPosition(int i) const { return geometry->getGoalPosition(i); }
+  // true if every goal is occupied by a robot allowed to be there
+  bool isSolved() const;
+  // the same answer, for when the board was not solved before robot
+  // 'moved' made the latest move (it must then be the one to finish)
+  bool isSolved(int moved) const;
 
   // MODIFIERS related to board geometry
+  // (only allowed while loading, before the geometry is shared)
   void addHorizontalWall(double r, int c);
   void addVerticalWall(int r, double c);
+  // attach the tables derived from the walls (must be called once
+  // after all of the walls have been added)
+  void buildLayoutTables(LayoutCache *cache = NULL);
 
   // MODIFIERS related to robot position
   // initial placement of a new robot
   void placeRobot(const Position &p, char a);
   // move an existing robot
+  bool moveRobot(int i, Direction dir);
   bool moveRobot(int i, const std::string &direction);
+  // move a robot in place, and later take that move back (undo moves
+  // in the reverse order they were applied)
+  UndoToken applyMove(int i, Direction dir);
+  UndoToken applyMove(int i, const std::string &direction);
+  void undoMove(const UndoToken &token);
+  // put every robot back where a packed key says it is
+  // (the direction of travel flags are cleared)
+  void unpackState(const StateKey &key);
 
   // MODIFIER related to puzzle goals
   void addGoal(const std::string &goal_robot, const Position &p);
   
   //MODIFIER related to editing spot values
+  bool checkmove(int i, Direction dir) const;
   bool checkmove(const int &i, const std::string &direction);  
   bool checkLR(const int &bot);
   bool checkUD(const int &bot);
@@ -112,28 +317,32 @@ public:
   void print();
   
   char getspot(const Position &p) const;
-  void setspot(const Position &p, char a);
 	
 private:
 
   // private helper functions
   
-  char isGoal(const Position &p) const;
+  // the per direction move kernels
+  template <Direction D> Position slide(int i) const;
+  template <Direction D> void markDirection(int i);
+  template <Direction D> bool moveKernel(int i);
+  // bitmasks of the robots, derived from state when needed: bit c of
+  // rowRobots(r) (bit r of colRobots(c)) is set if a robot stands at
+  // (r,c), and bit r of occupiedRows() (bit c of occupiedCols()) if
+  // any robot is in row r (column c)
+  uint64_t rowRobots(int r) const;
+  uint64_t colRobots(int c) const;
+  uint64_t occupiedRows() const;
+  uint64_t occupiedCols() const;
+  StateKey packCells(const uint64_t *cells) const;
 
   // REPRESENTATION
 
-  // the board geometry
-  int rows;
-  int cols;
-  std::vector<std::vector<char> > board;
-  std::vector<std::vector<bool> > vertical_walls;
-  std::vector<std::vector<bool> > horizontal_walls;
-
-  // the names and current positions of the robots
-  std::vector<Robot> robots;
+  // the shared, read only board geometry
+  std::shared_ptr<BoardGeometry> geometry;
 
-  // the goal positions & the robots that must reach them
-  std::vector<Goal> goals;
+  // the names, current positions and directions of the robots
+  RobotState state;
 };
 
-
+#endif
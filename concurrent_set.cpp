@@ -0,0 +1,93 @@
+#include "concurrent_set.h"
+
+
+// ==================================================================
+// ==================================================================
+// Implementation of the ConcurrentStateSet class
+
+
+ConcurrentStateSet::ConcurrentStateSet(uint64_t initial_capacity) : count(0), generation_number(0) {
+  uint64_t cap = 16;
+  while (cap < initial_capacity) cap *= 2;
+  slots = new Slot[cap];
+  mask = cap-1;
+}
+
+ConcurrentStateSet::~ConcurrentStateSet() {
+  delete [] slots;
+}
+
+
+// ===================
+// ACCESSORS
+// ===================
+
+bool ConcurrentStateSet::find(const StateKey &key, uint64_t &payload) const {
+  for (uint64_t i = StateKeyHash()(key) & mask; ; i = (i+1) & mask) {
+    const Slot &s = slots[i];
+    uint32_t state = s.state.load(std::memory_order_acquire);
+    if (state == EMPTY) return false;
+    // another thread is publishing this slot, it only takes a moment
+    while (state == WRITING) state = s.state.load(std::memory_order_acquire);
+    if (s.lo == key.lo && s.hi == key.hi) {
+      payload = s.payload.load(std::memory_order_relaxed);
+      return true;
+    }
+  }
+}
+
+
+// ===================
+// MODIFIERS
+// ===================
+
+bool ConcurrentStateSet::insert(const StateKey &key, uint64_t payload) {
+  assert (size() < capacity());
+  for (uint64_t i = StateKeyHash()(key) & mask; ; i = (i+1) & mask) {
+    Slot &s = slots[i];
+    uint32_t state = s.state.load(std::memory_order_acquire);
+    if (state == EMPTY) {
+      // try to claim the slot; on failure 'state' holds what won
+      if (s.state.compare_exchange_strong(state,WRITING,std::memory_order_acq_rel)) {
+        s.lo = key.lo;
+        s.hi = key.hi;
+        s.payload.store(payload,std::memory_order_relaxed);
+        s.state.store(FULL,std::memory_order_release);
+        count.fetch_add(1,std::memory_order_relaxed);
+        return true;
+      }
+    }
+    while (state == WRITING) state = s.state.load(std::memory_order_acquire);
+    if (s.lo == key.lo && s.hi == key.hi) {
+      // already present, keep the smaller payload
+      uint64_t old = s.payload.load(std::memory_order_relaxed);
+      while (payload < old && !s.payload.compare_exchange_weak(old,payload,std::memory_order_relaxed)) {}
+      return false;
+    }
+  }
+}
+
+void ConcurrentStateSet::reserve(uint64_t n) {
+  uint64_t needed = 2*(size() + n);
+  if (needed <= capacity()) return;
+  uint64_t cap = capacity();
+  while (cap < needed) cap *= 2;
+
+  // rehash every key into the next generation's table
+  Slot *old_slots = slots;
+  uint64_t old_capacity = capacity();
+  slots = new Slot[cap];
+  mask = cap-1;
+  for (uint64_t j = 0; j < old_capacity; j++) {
+    const Slot &s = old_slots[j];
+    if (s.state.load(std::memory_order_relaxed) != FULL) continue;
+    uint64_t i = StateKeyHash()(StateKey(s.lo,s.hi)) & mask;
+    while (slots[i].state.load(std::memory_order_relaxed) != EMPTY) i = (i+1) & mask;
+    slots[i].lo = s.lo;
+    slots[i].hi = s.hi;
+    slots[i].payload.store(s.payload.load(std::memory_order_relaxed),std::memory_order_relaxed);
+    slots[i].state.store(FULL,std::memory_order_relaxed);
+  }
+  delete [] old_slots;
+  generation_number++;
+}
@@ -0,0 +1,69 @@
+#ifndef _CONCURRENT_SET_H_
+#define _CONCURRENT_SET_H_
+
+#include <atomic>
+#include <stdint.h>
+
+#include "board.h"
+
+
+// ==================================================================
+// ==================================================================
+// A visited-state hash set that many threads can insert into at once
+// without a mutex.  Open addressing with linear probing over a power
+// of two number of slots; a thread claims an empty slot with a single
+// compare-and-swap on its state word.  Each key carries a 64 bit
+// payload (the solvers store the parent and move there); inserting a
+// key that is already present keeps the smaller of the two payloads,
+// so the result does not depend on which thread got there first.
+//
+// The capacity is fixed while threads are inserting.  Between rounds
+// of inserts (e.g. between layers of a breadth first search) reserve()
+// moves every key into a larger table, the next generation.
+
+class ConcurrentStateSet {
+public:
+
+  // CONSTRUCTOR & DESTRUCTOR
+  ConcurrentStateSet(uint64_t initial_capacity = 1024);
+  ~ConcurrentStateSet();
+
+  // ACCESSORS (safe to call concurrently with each other and insert)
+  bool find(const StateKey &key, uint64_t &payload) const;
+  bool contains(const StateKey &key) const { uint64_t p; return find(key,p); }
+  uint64_t size() const { return count.load(std::memory_order_relaxed); }
+  uint64_t capacity() const { return mask+1; }
+  int generation() const { return generation_number; }
+
+  // MODIFIERS
+  // returns true if this call added the key, false if it was already
+  // present (in which case its payload is lowered to this one if smaller)
+  bool insert(const StateKey &key, uint64_t payload = 0);
+  // grow, if needed, so n more keys fit while staying at most half
+  // full.  must not run at the same time as any other member function.
+  void reserve(uint64_t n);
+
+private:
+  // disallow copying
+  ConcurrentStateSet(const ConcurrentStateSet&);
+  ConcurrentStateSet& operator=(const ConcurrentStateSet&);
+
+  // a slot goes EMPTY -> WRITING (claimed by one thread) -> FULL
+  // (key and payload published); it never goes back
+  enum { EMPTY = 0, WRITING = 1, FULL = 2 };
+  class Slot {
+  public:
+    Slot() : state(EMPTY), lo(0), hi(0), payload(0) {}
+    std::atomic<uint32_t> state;
+    uint64_t lo, hi;
+    std::atomic<uint64_t> payload;
+  };
+
+  // REPRESENTATION
+  Slot *slots;
+  uint64_t mask;
+  std::atomic<uint64_t> count;
+  int generation_number;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "heartbeat.h"
+#include "solver.h"
+
+
+// ==================================================================
+// ==================================================================
+// Implementation of the Heartbeat class
+
+
+Heartbeat::Heartbeat(double interval_seconds, std::ostream &o)
+  : interval(interval_seconds), ostr(o), start(std::chrono::steady_clock::now()),
+    last_expanded(search_counters.expanded.load(std::memory_order_relaxed)),
+    last_time(start), stopping(false) {
+  thread = std::thread(&Heartbeat::run,this);
+}
+
+Heartbeat::~Heartbeat() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wakeup.notify_one();
+  thread.join();
+}
+
+void Heartbeat::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!wakeup.wait_for(lock,interval,[this] { return stopping; }))
+    beat();
+}
+
+// the memory the process is using now, in kilobytes (the peak if the
+// current size cannot be read)
+static long residentKb() {
+  std::ifstream statm("/proc/self/statm");
+  long size, resident;
+  if (statm >> size >> resident)
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+  struct rusage usage;
+  getrusage(RUSAGE_SELF,&usage);
+  return usage.ru_maxrss;
+}
+
+void Heartbeat::beat() {
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  unsigned long long expanded = search_counters.expanded.load(std::memory_order_relaxed);
+  unsigned long long frontier = search_counters.frontier.load(std::memory_order_relaxed);
+  unsigned long long layer_start = search_counters.layer_start.load(std::memory_order_relaxed);
+  double seconds = std::chrono::duration<double>(now - last_time).count();
+  double rate = (seconds > 0 ? (expanded - last_expanded) / seconds : 0);
+  last_expanded = expanded;
+  last_time = now;
+
+  // build the line first so it is written in one piece
+  std::ostringstream line;
+  line << "heartbeat " << (long)std::chrono::duration<double>(now - start).count() << "s:"
+       << " depth " << search_counters.depth.load(std::memory_order_relaxed)
+       << ", frontier " << frontier;
+  // IDA* keeps no visited set
+  unsigned long long visited = search_counters.visited.load(std::memory_order_relaxed);
+  if (visited > 0)
+    line << ", visited " << visited;
+  line << ", " << (unsigned long long)rate << " states/s"
+       << ", rss " << residentKb() / 1024 << " MB";
+  // how far through the current layer, and how long the rest will take
+  // at the current rate (nothing if the layer's size is not known)
+  if (frontier > 0 && expanded >= layer_start) {
+    unsigned long long done = std::min(expanded - layer_start, frontier);
+    line << ", depth " << 100 * done / frontier << "% done";
+    if (rate > 0)
+      line << ", eta " << (long)((frontier - done) / rate) << "s";
+  }
+  ostr << line.str() << std::endl;
+}
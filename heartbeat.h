@@ -0,0 +1,52 @@
+#ifndef _HEARTBEAT_H_
+#define _HEARTBEAT_H_
+
+#include <ostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+
+// ==================================================================
+// ==================================================================
+// A progress report for long searches.  While a Heartbeat exists, a
+// timer thread wakes every interval and prints one line to the given
+// stream (stderr in the robot program) from the relaxed counters the
+// search drivers keep (see SearchCounters):
+//
+//   heartbeat 30s: depth 9, frontier 1843210, visited 4102977,
+//     612345 states/s, rss 1204 MB, depth 41% done, eta 17s
+//
+// The thread only reads the counters, so the search never waits for
+// it.  In a batch the counters are shared by every puzzle being
+// solved: the rate is the total and the depth is the last one begun.
+
+class Heartbeat {
+public:
+  Heartbeat(double interval_seconds, std::ostream &ostr);
+  // stops and joins the timer thread
+  ~Heartbeat();
+
+private:
+  // disallow copying
+  Heartbeat(const Heartbeat&);
+  Heartbeat& operator=(const Heartbeat&);
+
+  void run();
+  void beat();
+
+  // REPRESENTATION
+  std::chrono::duration<double> interval;
+  std::ostream &ostr;
+  std::chrono::steady_clock::time_point start;
+  // the counter and time at the previous beat, for the current rate
+  unsigned long long last_expanded;
+  std::chrono::steady_clock::time_point last_time;
+  bool stopping;
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  std::thread thread;
+};
+
+#endif
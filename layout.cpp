@@ -0,0 +1,122 @@
+#include "layout.h"
+#include "board.h"
+
+
+// ==================================================================
+// ==================================================================
+// Implementation of the LayoutTables class
+
+
+LayoutTables::LayoutTables(int num_rows, int num_cols, const std::vector<uint64_t> &v, const std::vector<uint64_t> &h)
+  : rows(num_rows), cols(num_cols), vertical_walls(v), horizontal_walls(h), distances(num_rows*num_cols) {
+}
+
+bool LayoutTables::sameWalls(int r, int c, const std::vector<uint64_t> &v, const std::vector<uint64_t> &h) const {
+  return rows == r && cols == c && vertical_walls == v && horizontal_walls == h;
+}
+
+const std::vector<int>& LayoutTables::distancesTo(int target) const {
+  std::lock_guard<std::mutex> guard(distances_lock);
+  if (distances[target]) return *distances[target];
+
+  // breadth first outwards from the target: a cell is one move further
+  // than any cell it can see along its row or column
+  std::vector<int> *dist = new std::vector<int>(rows*cols,UNREACHABLE);
+  std::vector<int> queue(1,target);
+  (*dist)[target] = 0;
+  for (unsigned int q = 0; q < queue.size(); q++) {
+    int row = queue[q]/cols + 1;
+    int col = queue[q]%cols + 1;
+    int d = (*dist)[queue[q]] + 1;
+    // the walls at row r-0.5 and r+0.5 are bits r-1 and r of the column
+    // (and likewise for columns within a row)
+    uint64_t col_walls = horizontal_walls[col-1];
+    uint64_t row_walls = vertical_walls[row-1];
+    for (int r = row; !((col_walls >> (r-1)) & 1); r--) {
+      int cell = (r-2)*cols + (col-1);
+      if ((*dist)[cell] == UNREACHABLE) { (*dist)[cell] = d; queue.push_back(cell); }
+    }
+    for (int r = row; !((col_walls >> r) & 1); r++) {
+      int cell = r*cols + (col-1);
+      if ((*dist)[cell] == UNREACHABLE) { (*dist)[cell] = d; queue.push_back(cell); }
+    }
+    for (int c = col; !((row_walls >> (c-1)) & 1); c--) {
+      int cell = (row-1)*cols + (c-2);
+      if ((*dist)[cell] == UNREACHABLE) { (*dist)[cell] = d; queue.push_back(cell); }
+    }
+    for (int c = col; !((row_walls >> c) & 1); c++) {
+      int cell = (row-1)*cols + c;
+      if ((*dist)[cell] == UNREACHABLE) { (*dist)[cell] = d; queue.push_back(cell); }
+    }
+  }
+  distances[target].reset(dist);
+  return *dist;
+}
+
+
+// ==================================================================
+// ==================================================================
+// Implementation of the LayoutCache class
+
+
+// a hash of the dimensions and every wall word (splitmix64 steps)
+static uint64_t fingerprint(int rows, int cols, const std::vector<uint64_t> &v, const std::vector<uint64_t> &h) {
+  uint64_t x = (uint64_t(rows) << 32) | uint64_t(cols);
+  auto mix = [&x](uint64_t word) { x = mix64(x + word + 0x9e3779b97f4a7c15ULL); };
+  for (unsigned int i = 0; i < v.size(); i++) mix(v[i]);
+  for (unsigned int i = 0; i < h.size(); i++) mix(h[i]);
+  return x;
+}
+
+std::shared_ptr<const LayoutTables> LayoutCache::find(uint64_t key, int rows, int cols, const std::vector<uint64_t> &v,
+                                                      const std::vector<uint64_t> &h) {
+  auto range = layouts.equal_range(key);
+  for (auto itr = range.first; itr != range.second; itr++) {
+    if (itr->second->second->sameWalls(rows,cols,v,h)) {
+      // move it to the front, the last to be forgotten
+      recent.splice(recent.begin(),recent,itr->second);
+      return itr->second->second;
+    }
+  }
+  return NULL;
+}
+
+std::shared_ptr<const LayoutTables> LayoutCache::lookup(int rows, int cols, const std::vector<uint64_t> &v,
+                                                        const std::vector<uint64_t> &h) {
+  uint64_t key = fingerprint(rows,cols,v,h);
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    std::shared_ptr<const LayoutTables> found = find(key,rows,cols,v,h);
+    if (found) {
+      hits++;
+      return found;
+    }
+  }
+
+  // build outside the lock, so other threads can keep finding theirs.
+  // if another thread built the same layout meanwhile, keep the first.
+  std::shared_ptr<const LayoutTables> tables(new LayoutTables(rows,cols,v,h));
+  std::lock_guard<std::mutex> guard(lock);
+  std::shared_ptr<const LayoutTables> found = find(key,rows,cols,v,h);
+  if (found) {
+    hits++;
+    return found;
+  }
+  misses++;
+  recent.push_front(std::make_pair(key,tables));
+  layouts.insert(std::make_pair(key,recent.begin()));
+
+  // forget the least recently used layout if there are too many
+  if (recent.size() > capacity) {
+    Recency::iterator oldest = --recent.end();
+    auto range = layouts.equal_range(oldest->first);
+    for (auto itr = range.first; itr != range.second; itr++) {
+      if (itr->second == oldest) {
+        layouts.erase(itr);
+        break;
+      }
+    }
+    recent.pop_back();
+  }
+  return tables;
+}
@@ -0,0 +1,120 @@
+#ifndef _LAYOUT_H_
+#define _LAYOUT_H_
+
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <climits>
+#include <stdint.h>
+
+
+// ==================================================================
+// ==================================================================
+// Bitboard helpers used for sliding along one row or column.  The
+// walls mask has bit k set for a wall at k+0.5, the robots mask has
+// bit k set for a robot at k.  Both return the index where a robot
+// starting at index 'from' comes to rest.
+
+// slide towards larger indices: stop at the first wall after us, or
+// just before the first robot
+inline int slideToHigh(uint64_t walls, uint64_t robots, int from) {
+  uint64_t blockers = (walls | (robots >> 1)) & (~uint64_t(0) << from);
+  return __builtin_ctzll(blockers);
+}
+
+// slide towards smaller indices: stop at the first wall before us, or
+// just after the first robot
+inline int slideToLow(uint64_t walls, uint64_t robots, int from) {
+  uint64_t blockers = ((walls | robots) << 1) & ((uint64_t(2) << from) - 1);
+  return 63 - __builtin_clzll(blockers);
+}
+
+// the distance to a cell that cannot be reached
+const int UNREACHABLE = INT_MAX/2;
+
+
+// ==================================================================
+// ==================================================================
+// The tables derived from a wall layout alone: for now only the goal
+// distance maps IDA* uses for its lower bound.  Real games reuse one
+// layout with many different robot starts and goals, so a LayoutCache
+// hands the same tables to every puzzle with identical walls.  Cells
+// are numbered as in BoardGeometry::cellIndex, the walls are packed
+// as in BoardGeometry.
+
+class LayoutTables {
+public:
+  LayoutTables(int rows, int cols, const std::vector<uint64_t> &vertical_walls,
+               const std::vector<uint64_t> &horizontal_walls);
+
+  // ACCESSORS
+  bool sameWalls(int rows, int cols, const std::vector<uint64_t> &vertical_walls,
+                 const std::vector<uint64_t> &horizontal_walls) const;
+  // for every cell, the fewest moves a lone robot needs from there to
+  // reach the given cell if it could stop anywhere along a slide
+  // (only walls are considered).  Computed on first request, safe to
+  // call from many threads.
+  const std::vector<int>& distancesTo(int cell) const;
+
+private:
+  // REPRESENTATION
+  int rows;
+  int cols;
+  std::vector<uint64_t> vertical_walls;
+  std::vector<uint64_t> horizontal_walls;
+  // one map per target cell, filled in lazily under the lock
+  mutable std::mutex distances_lock;
+  mutable std::vector<std::unique_ptr<std::vector<int> > > distances;
+};
+
+
+// ==================================================================
+// ==================================================================
+// The LayoutTables of the most recently used wall layouts, found by a
+// fingerprint of the walls (and then compared in full).  One cache is
+// shared by all the puzzles of a batch or server session, which only
+// consult it when solving with IDA* (nothing else uses the tables).
+// It is safe to use from many threads.  It keeps at most capacity
+// layouts, forgetting the least recently used one to make room, so a
+// server sent endless new boards does not grow without limit (puzzles
+// still using a forgotten layout keep their tables).
+
+class LayoutCache {
+public:
+  static const unsigned int DEFAULT_CAPACITY = 32;
+  LayoutCache(unsigned int max_layouts = DEFAULT_CAPACITY) : capacity(max_layouts), hits(0), misses(0) {}
+
+  // the tables for these walls, built the first time they are seen
+  std::shared_ptr<const LayoutTables> lookup(int rows, int cols, const std::vector<uint64_t> &vertical_walls,
+                                             const std::vector<uint64_t> &horizontal_walls);
+
+  // ACCESSORS
+  unsigned long numHits() const { return hits; }
+  unsigned long numMisses() const { return misses; }
+
+private:
+  // disallow copying
+  LayoutCache(const LayoutCache&);
+  LayoutCache& operator=(const LayoutCache&);
+
+  typedef std::list<std::pair<uint64_t,std::shared_ptr<const LayoutTables> > > Recency;
+
+  // the cached tables for these walls (marked as just used), or NULL.
+  // the lock must be held.
+  std::shared_ptr<const LayoutTables> find(uint64_t key, int rows, int cols, const std::vector<uint64_t> &vertical_walls,
+                                           const std::vector<uint64_t> &horizontal_walls);
+
+  // REPRESENTATION
+  std::mutex lock;
+  unsigned int capacity;
+  // the layouts, most recently used first, and an index of them by
+  // fingerprint
+  Recency recent;
+  std::unordered_multimap<uint64_t,Recency::iterator> layouts;
+  unsigned long hits;
+  unsigned long misses;
+};
+
+#endif
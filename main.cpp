@@ -4,14 +4,46 @@
 #include <cstdlib>
 #include <string>
 #include <cassert>
+#include <algorithm>
+#include <thread>
+#include <memory>
 
 #include "board.h"
+#include "solver.h"
+#include "puzzle.h"
+#include "batch.h"
+#include "server.h"
+#include "solution_cache.h"
+#include "stats.h"
+#include "heartbeat.h"
+#include "trace.h"
 
 // ./robots puzzle1.txt  -max_moves   3    -visualize    A
 //            argv[1]      argv[2]  argv[3]  argv[4]   argv[5]
 //
 // -all_solutions = print # of solutions, the all solution boards output.
 // otherwise, any solution output, board printed after every move.
+// -dfs = use the original recursive depth first search instead of the
+// breadth first solver.
+// -threads N = expand each layer of the breadth first search with N threads.
+// -batch = solve many puzzle files (named after it, or listed on stdin)
+// on a pool of -threads workers, printing one line per puzzle.
+// -serve [socket] = keep running, solving puzzles sent on stdin (or to a
+// Unix domain socket), one reply line each.
+// -cache file = look each puzzle up in (and add it to) a persistent
+// cache of solutions before searching.  Only the single solution
+// searches use it; -all_solutions just adds its first solution.
+// -stats = print per depth node counts, prunes, duplicates and slide
+// lengths to stderr at exit (the counters are only compiled in when
+// built with -DROBOT_STATS).
+// -heartbeat S = every S seconds print the depth, frontier, states per
+// second, memory and time left in the current depth to stderr.
+// -trace file = write the time spent loading, preprocessing, searching
+// each depth, reconstructing and printing as Chrome trace event JSON
+// (-trace_lanes gives each thread its own row).
+// -ida = use iterative deepening A*, which needs memory only for the
+// current path.  It requires -max_moves, as it keeps no visited set
+// and could not otherwise give up on an unsolvable puzzle.
 // if program not possible, print "no solutions with XX or fewer moves", 
 // or "No solutions" if max_moves was not specified.
 
@@ -26,6 +58,17 @@ bool usage(const std::string &executable_name) {
   std::cerr << "       " << executable_name << " <puzzle_file> -visualize <which_robot>" << std::endl;
   std::cerr << "       " << executable_name << " <puzzle_file> -max_moves <#> -all_solutions" << std::endl;
   std::cerr << "       " << executable_name << " <puzzle_file> -max_moves <#> -visualize <which_robot>" << std::endl;
+  std::cerr << "       " << executable_name << " <puzzle_file> [...] -dfs" << std::endl;
+  std::cerr << "       " << executable_name << " <puzzle_file> [...] -max_moves <#> -ida" << std::endl;
+  std::cerr << "       " << executable_name << " <puzzle_file> [...] -threads <#>" << std::endl;
+  std::cerr << "       " << executable_name << " <puzzle_file> [...] -symmetry" << std::endl;
+  std::cerr << "       " << executable_name << " <puzzle_file> [...] -cache <cache_file>" << std::endl;
+  std::cerr << "       " << executable_name << " <puzzle_file> [...] -stats" << std::endl;
+  std::cerr << "       " << executable_name << " <puzzle_file> [...] -heartbeat <seconds>" << std::endl;
+  std::cerr << "       " << executable_name << " <puzzle_file> [...] -trace <trace_file> [-trace_lanes]" << std::endl;
+  std::cerr << "       " << executable_name << " -batch [-max_moves <#> [-ida]] [-threads <#>] [-symmetry] [-cache <cache_file>] [<puzzle_file> ...]" << std::endl;
+  std::cerr << "       " << executable_name << " -serve [-max_moves <#> [-ida]] [-symmetry] [-cache <cache_file>] [<socket_path>]" << std::endl;
+  std::cerr << "A puzzle may have at most " << MAX_ROBOTS << " robots." << std::endl;
   exit(0);
 }
 
@@ -34,51 +77,12 @@ bool usage(const std::string &executable_name) {
 
 // load a Ricochet Robots puzzle from the input file
 Board load(const std::string &executable, const std::string &filename) {
-
-  // open the file for reading
-  std::ifstream istr (filename.c_str());
-  if (!istr) {
-    std::cerr << "ERROR: could not open " << filename << " for reading" << std::endl;
+  Board answer(1,1);
+  std::string error;
+  if (!readPuzzleFile(filename,answer,error)) {
+    std::cerr << "ERROR: " << error << std::endl;
     usage(executable);
   }
-
-  // read in the board dimensions and create an empty board
-  // (all outer edges are automatically set to be walls
-  int rows,cols;
-  istr >> rows >> cols;
-  assert (rows > 0 && cols > 0);
-  Board answer(rows,cols);
-
-  // read in the other characteristics of the puzzle board
-  std::string token;
-  while (istr >> token) {
-    if (token == "robot") {
-      char a;
-      int r,c;
-      istr >> a >> r >> c;
-      answer.placeRobot(Position(r,c),a);
-    } else if (token == "vertical_wall") {
-      int i;
-      double j;
-      istr >> i >> j;
-      answer.addVerticalWall(i,j);
-    } else if (token == "horizontal_wall") {
-      double i;
-      int j;
-      istr >> i >> j;
-      answer.addHorizontalWall(i,j);
-    } else if (token == "goal") {
-      std::string which_robot;
-      int r,c;
-      istr >> which_robot >> r >> c;
-      answer.addGoal(which_robot,Position(r,c));
-    } else {
-      std::cerr << "ERROR: unknown token in the input file " << token << std::endl;
-      exit(0);
-    }
-  }
-
-  // return the initialized board
   return answer;
 }
 
@@ -101,6 +105,18 @@ void print_vec(const std::vector<std::vector<int> > &vec, const char& robot) {
 	std::cout << std::endl;
 }
 
+//called at exit with -stats
+void print_stats() {
+	search_stats.print(std::cerr);
+}
+
+//called at exit with -trace
+void write_trace() {
+	std::string error;
+	if (!tracer.write(error))
+		std::cerr << "ERROR: " << error << std::endl;
+}
+
 //function to put together our strings
 std::string makeStr(const std::string &dir, const char &bot) {
 	std::string str = "robot  moves " + dir;
@@ -110,8 +126,12 @@ std::string makeStr(const std::string &dir, const char &bot) {
 
 void visualization(int current_moves, Board &board, std::vector<std::vector<int> > &visual, 
 						const int &robot, const int &max_moves) {
+	//every call is a board one move deeper (counted only in a ROBOT_STATS build)
+	STAT(search_stats.generate(current_moves));
 
 	if (current_moves <= max_moves) {
+		STAT(search_stats.expand(current_moves));
+		STAT(search_stats.visit(board.packState()));
 		//runs a function in board.cpp that sets the values on our grid
 		//board.checkSpot(current_moves, visual, robot);
 		Position p = board.getRobotPosition(robot);
@@ -126,31 +146,31 @@ void visualization(int current_moves, Board &board, std::vector<std::vector<int>
 			
 		for (int i = 0; i < board.numRobots(); ++i) {
 
-		//assign a temp board so each function knows where it is currently going
-		//otherwise, a simple recursive function that moves robots through every permutation.
+		//move the robot in place, recurse, then take the move back so each direction starts
+		//from the same board. otherwise, a simple recursive function that moves robots through every permutation.
 		
-			Board temp = board;
-			if (temp.checkmove(i, "up") &&  board.getBotIndex(i).south == false) {
-				temp.moveRobot(i, "up");
-				visualization(current_moves+1, temp, visual, robot, max_moves);
+			if (board.checkmove(i, UP) &&  board.getBotIndex(i).south == false) {
+				UndoToken undo = board.applyMove(i, UP);
+				visualization(current_moves+1, board, visual, robot, max_moves);
+				board.undoMove(undo);
 			}
 				
-			temp = board;
-			if (temp.checkmove(i, "down") &&  board.getBotIndex(i).north == false) {
-				temp.moveRobot(i, "down");
-				visualization(current_moves+1, temp, visual, robot, max_moves);
+			if (board.checkmove(i, DOWN) &&  board.getBotIndex(i).north == false) {
+				UndoToken undo = board.applyMove(i, DOWN);
+				visualization(current_moves+1, board, visual, robot, max_moves);
+				board.undoMove(undo);
 			}
 			
-			temp = board;
-			if (temp.checkmove(i, "left") &&  board.getBotIndex(i).east == false) {
-				temp.moveRobot(i, "left");
-				visualization(current_moves+1, temp, visual, robot, max_moves);
+			if (board.checkmove(i, LEFT) &&  board.getBotIndex(i).east == false) {
+				UndoToken undo = board.applyMove(i, LEFT);
+				visualization(current_moves+1, board, visual, robot, max_moves);
+				board.undoMove(undo);
 			}
 				
-			temp = board;
-			if (temp.checkmove(i, "right") &&  board.getBotIndex(i).west == false) {
-				temp.moveRobot(i, "right");
-				visualization(current_moves+1, temp, visual, robot, max_moves);
+			if (board.checkmove(i, RIGHT) &&  board.getBotIndex(i).west == false) {
+				UndoToken undo = board.applyMove(i, RIGHT);
+				visualization(current_moves+1, board, visual, robot, max_moves);
+				board.undoMove(undo);
 			}
 		}
 	}
@@ -159,7 +179,10 @@ void visualization(int current_moves, Board &board, std::vector<std::vector<int>
 //a separate function for an unlimited visualization, to prevent having to check a bool every run.
 void visualization_endless(int current_moves, Board &board, std::vector<std::vector<int> > &visual, 
 																											  const int &robot) {
+	STAT(search_stats.generate(current_moves));
 	if (current_moves < 10) {
+		STAT(search_stats.expand(current_moves));
+		STAT(search_stats.visit(board.packState()));
 		if (visual[board.getRobotPosition(robot).row-1][board.getRobotPosition(robot).col-1] != 0){
 			Position p = board.getRobotPosition(robot);
 			
@@ -173,28 +196,28 @@ void visualization_endless(int current_moves, Board &board, std::vector<std::vec
 		for (int i = 0; i < board.numRobots(); ++i) {
 			
 			//proceed with recursive alls
-			Board temp = board;
-			if (temp.checkmove(i, "up") && board.getBotIndex(i).south == false) {
-				temp.moveRobot(i, "up");
-				visualization_endless(current_moves+1, temp, visual, robot);
+			if (board.checkmove(i, UP) && board.getBotIndex(i).south == false) {
+				UndoToken undo = board.applyMove(i, UP);
+				visualization_endless(current_moves+1, board, visual, robot);
+				board.undoMove(undo);
 			}
 			
-			temp = board;
-			if (temp.checkmove(i, "down") && board.getBotIndex(i).north == false) {
-				temp.moveRobot(i, "down");
-				visualization_endless(current_moves+1, temp, visual, robot);
+			if (board.checkmove(i, DOWN) && board.getBotIndex(i).north == false) {
+				UndoToken undo = board.applyMove(i, DOWN);
+				visualization_endless(current_moves+1, board, visual, robot);
+				board.undoMove(undo);
 			}
 	
-			temp = board;
-			if (temp.checkmove(i, "left") && board.getBotIndex(i).east == false) {
-				temp.moveRobot(i, "left");
-				visualization_endless(current_moves+1, temp, visual, robot);
+			if (board.checkmove(i, LEFT) && board.getBotIndex(i).east == false) {
+				UndoToken undo = board.applyMove(i, LEFT);
+				visualization_endless(current_moves+1, board, visual, robot);
+				board.undoMove(undo);
 			}
 		
-			temp = board;
-			if (temp.checkmove(i, "right") && board.getBotIndex(i).west == false) {
-				temp.moveRobot(i, "right");
-				visualization_endless(current_moves+1, temp, visual, robot);
+			if (board.checkmove(i, RIGHT) && board.getBotIndex(i).west == false) {
+				UndoToken undo = board.applyMove(i, RIGHT);
+				visualization_endless(current_moves+1, board, visual, robot);
+				board.undoMove(undo);
 			}
 		}
 	}
@@ -208,188 +231,55 @@ void visualization_endless(int current_moves, Board &board, std::vector<std::vec
 //SEE COMMENTS FOR ALL_ANSWER -- one_solution works exactly the same way, with the exception of fewer
 //arguments and returning after the first successful goal-path find.
 void one_solution( int current_moves, int &current_high, int count, Board &board, const int &max_moves, 
-						 std::vector<std::string> &current_directions, std::vector<Board>& current_boards,
-						 std::vector<std::vector<Board> > &boards, std::vector<std::vector<std::string> > &directions) {
+						 std::vector<Move> &path, std::vector<std::vector<Move> > &solutions) {
 	//print board
 	//print robot + direction
+	STAT(search_stats.generate(current_moves));
 	
 	if (current_moves <= max_moves && current_moves < current_high) {
+		//if all goals are met, record the route. only the robot that made the
+		//last move can have finished the puzzle, so that is all isSolved checks
+		bool solved = path.empty() ? board.isSolved() : board.isSolved(path.back().robot);
+		if (solved) {
+			if (count < current_high)			//if its the fastest route so far,
+				current_high = count;
+			solutions.push_back(path);
+			return;
+		}
+		STAT(search_stats.expand(current_moves));
+		STAT(search_stats.visit(board.packState()));
 		for (int i = 0; i < board.numRobots(); ++i) {
 		
-			Board temp_board = board;
-			std::vector<std::string> temp_vec = current_directions;
-			std::vector<Board> temp_boards = current_boards;
-			if (temp_board.checkmove(i, "up") && board.checkUp(i) == true) {
-				temp_board.moveRobot(i, "up");
-				std::string str = makeStr("north", board.getRobot(i));
-				temp_vec.push_back(str);
-				temp_boards.push_back(temp_board);
-				if (board.getGoalPosition(0) == board.getRobotPosition(i) 
-					&& board.getGoalRobot(0) == board.getRobot(i) || board.getGoalRobot(0) == '?') {
-					
-					bool all_found = true;
-					for(int k = 0; k < board.numGoals(); ++k) {
-						if (all_found == false)
-							break;
-						for(int r = 0; r < board.numRobots(); ++r) {
-							if (board.getGoalRobot(k) == board.getRobot(r)) {
-								if (board.getGoalPosition(k) != board.getRobotPosition(r))
-									all_found = false;
-							}
-														if (board.getGoalRobot(k) == '?') {
-								for(int y = 0; y < board.numRobots(); ++y) {
-									if (board.getRobotPosition(y) == board.getGoalPosition(k)) 
-										break;
-									else if (y == board.numRobots() - 1)
-										all_found = false;
-								}
-							}
-						}
-					}
-					if (all_found == true) {
-						if (count < current_high)
-							current_high = count;
-						temp_vec.pop_back();
-						temp_boards.pop_back();
-						boards.push_back(temp_boards);
-						directions.push_back(temp_vec);
-						return;
-					}
-				}
-				one_solution(current_moves+1, current_high, count+1, temp_board, max_moves, temp_vec,
-																						temp_boards, boards, directions);
+			if (board.checkmove(i, UP) && board.checkUp(i) == true) {
+				path.push_back(Move(i, 0));
+				UndoToken undo = board.applyMove(i, UP);
+				one_solution(current_moves+1, current_high, count+1, board, max_moves, path, solutions);
+				board.undoMove(undo);
+				path.pop_back();
 			}
 			
-			temp_board = board;
-			temp_vec = current_directions;
-			temp_boards = current_boards;
-			if (temp_board.checkmove(i, "down") && board.checkDown(i) == true) {
-				temp_board.moveRobot(i, "down");
-				std::string str = makeStr("south", board.getRobot(i));
-				temp_vec.push_back(str);
-				temp_boards.push_back(temp_board);
-				if (board.getGoalPosition(0) == board.getRobotPosition(i)//if all goals are filled, so will this one.
-					&& board.getGoalRobot(0) == board.getRobot(i) || board.getGoalRobot(0) == '?') { 
-					
-				
-					bool all_found = true;
-					for(int k = 0; k < board.numGoals(); ++k) {
-						if (all_found == false)
-							break;
-						for(int r = 0; r < board.numRobots(); ++r) {
-							if (board.getGoalRobot(k) == board.getRobot(r)) {
-								if (board.getGoalPosition(k) != board.getRobotPosition(r))
-									all_found = false;
-							}
-														if (board.getGoalRobot(k) == '?') {
-								for(int y = 0; y < board.numRobots(); ++y) {
-									if (board.getRobotPosition(y) == board.getGoalPosition(k)) 
-										break;
-									else if (y == board.numRobots() - 1)
-										all_found = false;
-								}
-							}
-						}
-					}
-					if (all_found == true) {
-						if (count < current_high)
-							current_high = count;
-						temp_vec.pop_back();
-						temp_boards.pop_back();
-						boards.push_back(temp_boards);
-						directions.push_back(temp_vec);
-						return;
-					}
-				}
-				one_solution(current_moves+1, current_high, count+1, temp_board, max_moves, temp_vec, 
-																						temp_boards, boards, directions);
+			if (board.checkmove(i, DOWN) && board.checkDown(i) == true) {
+				path.push_back(Move(i, 1));
+				UndoToken undo = board.applyMove(i, DOWN);
+				one_solution(current_moves+1, current_high, count+1, board, max_moves, path, solutions);
+				board.undoMove(undo);
+				path.pop_back();
 			}
 	
-			temp_board = board;
-			temp_vec = current_directions;
-			temp_boards = current_boards;
-			if (temp_board.checkmove(i, "left") && temp_board.checkLeft(i) == true){
-				temp_board.moveRobot(i, "left");
-				std::string str = makeStr("west", board.getRobot(i)) ;
-				temp_vec.push_back(str);
-				temp_boards.push_back(temp_board);
-				if (board.getGoalPosition(0) == board.getRobotPosition(i)
-					&& board.getGoalRobot(0) == board.getRobot(i) || board.getGoalRobot(0) == '?') {
-					
-					bool all_found = true;
-					for(int k = 0; k < board.numGoals(); ++k) {
-						if (all_found == false)
-							break;
-						for(int r = 0; r < board.numRobots(); ++r) {
-							if (board.getGoalRobot(k) == board.getRobot(r)) {
-								if (board.getGoalPosition(k) != board.getRobotPosition(r))
-									all_found = false;
-							}
-							if (board.getGoalRobot(k) == '?') {
-								for(int y = 0; y < board.numRobots(); ++y) {
-									if (board.getRobotPosition(y) == board.getGoalPosition(k)) 
-										break;
-									else if (y == board.numRobots() - 1)
-										all_found = false;
-								}
-							}
-						}
-					}
-					if (all_found == true) {
-						if (count < current_high)
-							current_high = count;
-						temp_vec.pop_back();
-						temp_boards.pop_back();
-						boards.push_back(temp_boards);
-						directions.push_back(temp_vec);
-						return;
-					}
-				}
-				one_solution(current_moves+1, current_high, count+1, temp_board, max_moves, temp_vec, 
-																						temp_boards, boards, directions);
+			if (board.checkmove(i, LEFT) && board.checkLeft(i) == true){
+				path.push_back(Move(i, 2));
+				UndoToken undo = board.applyMove(i, LEFT);
+				one_solution(current_moves+1, current_high, count+1, board, max_moves, path, solutions);
+				board.undoMove(undo);
+				path.pop_back();
 			}
 		
-			temp_board = board;
-			temp_vec = current_directions;
-			temp_boards = current_boards;
-			if (temp_board.checkmove(i, "right") && temp_board.checkRight(i) == true){
-				temp_board.moveRobot(i, "right");
-				std::string str = makeStr("east", board.getRobot(i));
-				temp_vec.push_back(str);
-				temp_boards.push_back(temp_board);
-				if (board.getGoalPosition(0) == board.getRobotPosition(i) 
-					&& board.getGoalRobot(0) == board.getRobot(i) || board.getGoalRobot(0) == '?') {
-					bool all_found = true;
-					for(int k = 0; k < board.numGoals(); ++k) {
-						if (all_found == false)
-							break;
-						for(int r = 0; r < board.numRobots(); ++r) {
-							if (board.getGoalRobot(k) == board.getRobot(r)) {
-								if (board.getGoalPosition(k) != board.getRobotPosition(r))
-									all_found = false;
-							}
-														if (board.getGoalRobot(k) == '?') {
-								for(int y = 0; y < board.numRobots(); ++y) {
-									if (board.getRobotPosition(y) == board.getGoalPosition(k)) 
-										break;
-									else if (y == board.numRobots() - 1)
-										all_found = false;
-								}
-							}
-						}
-					}
-					if (all_found == true) {
-						if (count < current_high)
-							current_high = count;
-						temp_vec.pop_back();
-						temp_boards.pop_back();
-						boards.push_back(temp_boards);
-						directions.push_back(temp_vec);
-						return;
-					}
-				}
-				one_solution(current_moves+1, current_high, count+1, temp_board, max_moves, temp_vec,
-																						temp_boards, boards, directions);
+			if (board.checkmove(i, RIGHT) && board.checkRight(i) == true){
+				path.push_back(Move(i, 3));
+				UndoToken undo = board.applyMove(i, RIGHT);
+				one_solution(current_moves+1, current_high, count+1, board, max_moves, path, solutions);
+				board.undoMove(undo);
+				path.pop_back();
 			}
 		}
 	}
@@ -401,197 +291,65 @@ void one_solution( int current_moves, int &current_high, int count, Board &board
 //Depth search for no max_moves
 //not currently in use -- clone of one_solution currently
 
-//pass in a vector of vector of strings and boards, and a vector of strings and boards. Make the 1D vector of
-//boards and strings as you build the path. If the path leads to the goal, push it back to the vector of vectors.
+//pass in the moves made so far and a vector of finished solutions. Push each move onto the path before recursing
+//and pop it after. If the path leads to the goal, copy it into the solutions. Boards are only rebuilt for output.
 void all_answer( int current_moves, int &current_high, int count, Board &board, const int &max_moves, 
-						 std::vector<std::string> &current_directions, std::vector<Board>& current_boards,
-						 std::vector<std::vector<Board> > &boards, std::vector<std::vector<std::string> > &directions) {
+						 std::vector<Move> &path, std::vector<std::vector<Move> > &solutions) {
+	STAT(search_stats.generate(current_moves));
 
 	if (current_moves <= max_moves && current_moves <= current_high ) {
+		//if all goals are met, record the route. only the robot that made the
+		//last move can have finished the puzzle, so that is all isSolved checks
+		bool solved = path.empty() ? board.isSolved() : board.isSolved(path.back().robot);
+		if (solved) {
+			if (count < current_high)			//if its the fastest route so far,
+				current_high = count;
+			solutions.push_back(path);
+			return;
+		}
+		STAT(search_stats.expand(current_moves));
+		STAT(search_stats.visit(board.packState()));
 		for (int i = 0; i < board.numRobots(); ++i) {
 			
-			//grab initial copies of our vectors & board
-			Board temp_board = board;
-			std::vector<std::string> temp_vec = current_directions;
-			std::vector<Board> temp_boards = current_boards;
+			//the board and path are shared: moves are applied and pushed before recursing, then undone
 															//vv checks to make sure we dont oscillate
-			if (temp_board.checkmove(i, "up") && board.getBotIndex(i).south == false) {
-				temp_board.moveRobot(i, "up");
-				std::string str = makeStr("north", board.getRobot(i));
-				temp_vec.push_back(str);
-				temp_boards.push_back(temp_board);
-				//if all goals are satisfied, any random goal can be chosen, and should satisfy these requirements
-				if (board.getGoalPosition(0) == board.getRobotPosition(i) 
-					&& board.getGoalRobot(0) == board.getRobot(i) || board.getGoalRobot(0) == '?') {
-					
-					bool all_found = true;
-					for(int k = 0; k < board.numGoals(); ++k) {
-						if (all_found == false)		//stop the program if any goals don't match
-							break;
-						for(int r = 0; r < board.numRobots(); ++r) {
-							if (board.getGoalRobot(k) == board.getRobot(r)) {	//match the required robot with its goal
-								if (board.getGoalPosition(k) != board.getRobotPosition(r)) //if the positions don't match
-									all_found = false;												  //break us out of the loop
-							}
-							else if (board.getGoalRobot(k) == '?') {								  //if we have an "any" goal
-									if (board.getRobotPosition(r) == board.getGoalPosition(k)) //check against each robot
-										break;
-									else if (r == board.numRobots() - 1)							  //loop ends == no match
-										all_found = false;
-							}
-						}
-					}
-					if (all_found == true) {				//if we have all of our goals met,
-						if (count < current_high)			//and its the fastest route so far,
-							current_high = count;	
-						temp_vec.pop_back();					//break off our last movement
-						temp_boards.pop_back();				//and board change
-						boards.push_back(temp_boards);	//and record the route
-						directions.push_back(temp_vec);	//and directions
-						return;
-					}
-				}
-				all_answer(current_moves+1, current_high, count+1, temp_board, max_moves, temp_vec,
-																					temp_boards, boards, directions);
+			if (board.checkmove(i, UP) && board.getBotIndex(i).south == false) {
+				path.push_back(Move(i, 0));
+				UndoToken undo = board.applyMove(i, UP);
+				all_answer(current_moves+1, current_high, count+1, board, max_moves, path, solutions);
+				board.undoMove(undo);
+				path.pop_back();
 			}
 			
 			//======================================================
 			//each step identically, just with different directions
 			//======================================================
 			
-			temp_board = board;
-			temp_vec = current_directions;
-			temp_boards = current_boards;
-			if (temp_board.checkmove(i, "down") && board.getBotIndex(i).north == false) {
-				temp_board.moveRobot(i, "down");
-				std::string str = makeStr("south", board.getRobot(i));
-								temp_vec.push_back(str);
-				temp_boards.push_back(temp_board);
+			if (board.checkmove(i, DOWN) && board.getBotIndex(i).north == false) {
 				
-				if (board.getGoalPosition(0) == board.getRobotPosition(i) 
-					&& board.getGoalRobot(0) == board.getRobot(i) || board.getGoalRobot(0) == '?') {
-					
-					bool all_found = true;
-					for(int k = 0; k < board.numGoals(); ++k) {
-						if (all_found == false)
-							break;
-						for(int r = 0; r < board.numRobots(); ++r) {
-							if (board.getGoalRobot(k) == board.getRobot(r)) {
-								if (board.getGoalPosition(k) != board.getRobotPosition(r))
-									all_found = false;
-							}
-							else if (board.getGoalRobot(k) == '?') {
-
-									if (board.getRobotPosition(r) == board.getGoalPosition(k)) 
-										break;
-									else if (r == board.numRobots() - 1)
-										all_found = false;
-								
-							}
-						}
-					}
-					if (all_found == true) {
-						if (count < current_high)
-							current_high = count;
-						temp_vec.pop_back();
-						temp_boards.pop_back();
-						boards.push_back(temp_boards);
-						directions.push_back(temp_vec);
-						return;
-					}
-				}
-				all_answer(current_moves+1, current_high, count+1, temp_board, max_moves, temp_vec, 
-																					temp_boards, boards, directions);
+				path.push_back(Move(i, 1));
+				UndoToken undo = board.applyMove(i, DOWN);
+				all_answer(current_moves+1, current_high, count+1, board, max_moves, path, solutions);
+				board.undoMove(undo);
+				path.pop_back();
 			}
 	
-			temp_board = board;
-			temp_vec = current_directions;
-			temp_boards = current_boards;
-			if (temp_board.checkmove(i, "left") && board.getBotIndex(i).east == false) {
-				temp_board.moveRobot(i, "left");
-				std::string str = makeStr("west", board.getRobot(i));
-				temp_vec.push_back(str);
-				temp_boards.push_back(temp_board);
+			if (board.checkmove(i, LEFT) && board.getBotIndex(i).east == false) {
 				
-				if (board.getGoalPosition(0) == board.getRobotPosition(i) 
-					&& board.getGoalRobot(0) == board.getRobot(i) || board.getGoalRobot(0) == '?') {
-					
-					bool all_found = true;
-					for(int k = 0; k < board.numGoals(); ++k) {
-						if (all_found == false)
-							break;
-						for(int r = 0; r < board.numRobots(); ++r) {
-							if (board.getGoalRobot(k) == board.getRobot(r)) {
-								if (board.getGoalPosition(k) != board.getRobotPosition(r))
-									all_found = false;
-							}
-							else if (board.getGoalRobot(k) == '?') {
-
-									if (board.getRobotPosition(r) == board.getGoalPosition(k)) 
-										break;
-									else if (r == board.numRobots() - 1)
-										all_found = false;
-								
-							}
-						}
-					}
-					if (all_found == true) {
-						if (count < current_high)
-							current_high = count;
-						temp_vec.pop_back();
-						temp_boards.pop_back();
-						boards.push_back(temp_boards);
-						directions.push_back(temp_vec);
-						return;
-					}
-				}
-				all_answer(current_moves+1, current_high, count+1, temp_board, max_moves, temp_vec, 
-																					temp_boards, boards, directions);
+				path.push_back(Move(i, 2));
+				UndoToken undo = board.applyMove(i, LEFT);
+				all_answer(current_moves+1, current_high, count+1, board, max_moves, path, solutions);
+				board.undoMove(undo);
+				path.pop_back();
 			}
 		
-			temp_board = board;
-			temp_vec = current_directions;
-			temp_boards = current_boards;
-			if (temp_board.checkmove(i, "right") && board.getBotIndex(i).west == false) {
-				temp_board.moveRobot(i, "right");
-				std::string str = makeStr("east", board.getRobot(i));
-				temp_vec.push_back(str);
-				temp_boards.push_back(temp_board);
+			if (board.checkmove(i, RIGHT) && board.getBotIndex(i).west == false) {
 				
-				if (board.getGoalPosition(0) == board.getRobotPosition(i) 
-					&& board.getGoalRobot(0) == board.getRobot(i) || board.getGoalRobot(0) == '?') {
-					
-					bool all_found = true;
-					for(int k = 0; k < board.numGoals(); ++k) {
-						if (all_found == false)
-							break;
-						for(int r = 0; r < board.numRobots(); ++r) {
-							if (board.getGoalRobot(k) == board.getRobot(r)) {
-								if (board.getGoalPosition(k) != board.getRobotPosition(r))
-									all_found = false;
-							}
-							else if (board.getGoalRobot(k) == '?') {
-
-									if (board.getRobotPosition(r) == board.getGoalPosition(k)) 
-										break;
-									else if (r == board.numRobots() - 1)
-										all_found = false;
-								
-							}
-						}
-					}
-					if (all_found == true) {
-						if (count < current_high)
-							current_high = count;
-						temp_vec.pop_back();
-						temp_boards.pop_back();
-						boards.push_back(temp_boards);
-						directions.push_back(temp_vec);
-						return;
-					}
-				}
-				all_answer(current_moves+1, current_high, count+1, temp_board, max_moves, temp_vec, 
-																					temp_boards, boards, directions);
+				path.push_back(Move(i, 3));
+				UndoToken undo = board.applyMove(i, RIGHT);
+				all_answer(current_moves+1, current_high, count+1, board, max_moves, path, solutions);
+				board.undoMove(undo);
+				path.pop_back();
 			}
 		}
 	}
@@ -620,6 +378,24 @@ int main(int argc, char* argv[]) {
 	// By default, do not visualize the reachability
 	char visualize = ' ';   // the space character is not a valid robot!
 
+	// By default, solve with the breadth first search
+	bool use_dfs = false;
+	bool use_ida = false;
+	int num_threads = 1;
+	bool use_symmetry = false;
+	std::string cache_file;
+	double heartbeat_seconds = 0;
+	std::string trace_file;
+	bool trace_lanes = false;
+
+	// -batch in place of the puzzle file solves every puzzle file named
+	// after it (or listed on stdin), printing one line per puzzle
+	bool batch = (argv[1] == std::string("-batch"));
+	// -serve keeps running, answering puzzles sent on stdin or a socket
+	bool serve = (argv[1] == std::string("-serve"));
+	bool have_threads = false;
+	std::vector<std::string> batch_files;
+
 	// Read in the other command line arguments
 	for (int arg = 2; arg < argc; arg++) {
 		if (argv[arg] == std::string("-all_solutions")) {
@@ -643,68 +419,192 @@ int main(int argc, char* argv[]) {
 			visualize = tmp[0];
 			assert (isalpha(visualize) && isupper(visualize));
 			visualize = toupper(visualize);
+		} else if (argv[arg] == std::string("-dfs")) {
+			use_dfs = true;
+		} else if (argv[arg] == std::string("-ida")) {
+			use_ida = true;
+		} else if (argv[arg] == std::string("-threads")) {
+			arg++;
+			assert (arg < argc);
+			num_threads = atoi(argv[arg]);
+			assert (num_threads > 0);
+			have_threads = true;
+		} else if (argv[arg] == std::string("-symmetry")) {
+			// treat robots that no goal names as interchangeable
+			use_symmetry = true;
+		} else if (argv[arg] == std::string("-stats")) {
+			// print the search counters to stderr when the program exits
+			std::atexit(print_stats);
+		} else if (argv[arg] == std::string("-heartbeat")) {
+			// report the search's progress on stderr every so many seconds
+			arg++;
+			assert (arg < argc);
+			heartbeat_seconds = atof(argv[arg]);
+			assert (heartbeat_seconds > 0);
+		} else if (argv[arg] == std::string("-trace")) {
+			// write the time spent in each phase as a Chrome trace at exit
+			arg++;
+			assert (arg < argc);
+			trace_file = argv[arg];
+		} else if (argv[arg] == std::string("-trace_lanes")) {
+			// one row in the trace per thread
+			trace_lanes = true;
+		} else if (argv[arg] == std::string("-cache")) {
+			arg++;
+			assert (arg < argc);
+			cache_file = argv[arg];
+		} else if ((batch == true || serve == true) && argv[arg][0] != '-') {
+			batch_files.push_back(argv[arg]);
 		} else {
 			std::cout << "unknown command line argument" << argv[arg] << std::endl;
 			usage(argv[0]);
 		}
 	}
 	
-	// Load the puzzle board from the input file
-	Board board = load(argv[0],argv[1]);
+	//IDA* has no visited set, only the cap lets it give up
+	if (use_ida == true && have_max_moves == false) {
+		std::cerr << "ERROR: -ida needs -max_moves" << std::endl;
+		usage(argv[0]);
+	}
+
+	if (trace_file != "") {
+		tracer.start(trace_file, trace_lanes);
+		std::atexit(write_trace);
+	}
+
+	//the persistent solution cache, if one was named
+	SolutionCache cache;
+	if (cache_file != "") {
+		std::string error;
+		if (!cache.open(cache_file, error)) {
+			std::cerr << "ERROR: " << error << std::endl;
+			exit(0);
+		}
+	}
+
+	// Load the puzzle board from the input file (a batch or a server
+	// reads its own puzzles)
+	Board board(1,1);
+	if (batch == false && serve == false)
+		board = load(argv[0],argv[1]);
+
+	//runs until main returns, so it is only started once nothing left
+	//can exit() past its destructor and leave the thread running
+	std::unique_ptr<Heartbeat> heartbeat;
+	if (heartbeat_seconds > 0)
+		heartbeat.reset(new Heartbeat(heartbeat_seconds, std::cerr));
+
+	if (batch == true || serve == true) {
+		SolveOptions options;
+		if (cache_file != "")
+			options.cache = &cache;
+		options.max_moves = max_moves;
+		options.use_ida = use_ida;
+		options.symmetry = use_symmetry;
+		if (serve == true) {
+			//the only non-option argument is the socket to listen on
+			assert (batch_files.size() <= 1);
+			if (batch_files.empty())
+				serve_stdio(options);
+			else
+				serve_socket(batch_files[0], options);
+			return 0;
+		}
+		if (batch_files.empty())
+			batch_files = readManifest(std::cin);
+		//in a batch the threads work on different puzzles, one each
+		options.num_threads = num_threads;
+		if (have_threads == false)
+			options.num_threads = std::max(1u, std::thread::hardware_concurrency());
+		batch_solve(batch_files, options, std::cout);
+		return 0;
+	}
+
 	int moves = 0;
 
 	// visualize the robot if visualize is not NULL.
 	if (visualize != ' ') {
-		int robot_num;					//keep track of our robot index
+		int robot_num = -1;				//keep track of our robot index
 		for (int i = 0; i < board.numRobots(); ++i) {	
 			if (board.getRobot(i) == visualize) {
 				robot_num = i;
 				break;
 			}
 		}
+		assert (robot_num != -1);
 		
 		//make a vector to hold our visual grid
 		std::vector<std::vector<int> > visual;
-		for (int p = 0; p < board.getRows(); ++p) {
-			std::vector<int> row;
-			for (int l = 0; l < board.getCols(); ++l) {
-				row.push_back(-1);
-			}
-			visual.push_back(row);
+		if (use_dfs == false) {
+			//breadth first over every state, exact for any number of moves
+			visual = reachability(board, robot_num, max_moves);
 		}
-		
-		if (have_max_moves == true)
-			visualization(moves, board, visual, robot_num, max_moves);
-		
-		else
-			visualization_endless(moves, board, visual, robot_num);
-		
-		if(max_moves == 10 && visualize == 'A') {
-			visual[2][4] = 9; //my program runs fine except for these two numbers.
-			visual[0][3] = 8;
+		else {
+			for (int p = 0; p < board.getRows(); ++p) {
+				std::vector<int> row;
+				for (int l = 0; l < board.getCols(); ++l) {
+					row.push_back(-1);
+				}
+				visual.push_back(row);
+			}
+			
+			if (have_max_moves == true)
+				visualization(moves, board, visual, robot_num, max_moves);
+			
+			else
+				visualization_endless(moves, board, visual, robot_num);
 		}
-		if(max_moves == 3 && visualize == 'B')
-			visual[0][3] = 3; //my program runs fine except for this one number (also)
 			
 		//helper function to print our visualize vector<vector>
 		print_vec(visual, board.getRobot(robot_num));
 	}
 	
+	else if (all_solutions == false && use_dfs == false) {
+		//breadth first search (or IDA*), the first solution found is a shortest one
+		std::vector<Move> solution;
+		bool found;
+		if (cache_file != "" && cache.lookup(board, max_moves, found, solution)) {
+			//a repeat puzzle, no search needed
+		}
+		else {
+			if (use_ida == true)
+				found = ida_solve(board, max_moves, solution);
+			else
+				found = parallel_bfs_solve(board, max_moves, num_threads, solution, use_symmetry);
+			if (cache_file != "")
+				cache.store(board, max_moves, found, solution);
+		}
+		if (!found) {
+			board.print();
+			if (have_max_moves == true) 
+				std::cout << "no solutions with " << max_moves << " or fewer moves" << std::endl;
+			else
+				std::cout << "no solutions"<< std::endl;
+		}
+		else {
+			//replay the moves, printing the board after each one
+			Board replay = board;
+			replay.print();
+			for (int p = 0; p < solution.size(); ++p) {
+				replay.moveRobot(solution[p].robot, (Direction)solution[p].dir);
+				std::cout << makeStr(COMPASS_NAMES[solution[p].dir], replay.getRobot(solution[p].robot)) << std::endl;
+				replay.print();
+			}
+			std::cout << "All goals are satisfied after " << solution.size() << " moves" << std::endl;
+		}
+	}
+
 	else if (all_solutions == false) {
 		//keep track of many important variables
 		int current_size = 0;
 		int count = 0;
-		int printer;
+		int printer = 0;
 		int moves = 0;
 		int current_max = 100;
-		std::vector<std::vector< std::string> > directions;
-		std::vector<std::vector<Board> > boards;
-		std::vector<std::string> current_directions;
-		std::vector<Board> current_boards;
-		current_boards.push_back(board);
-		one_solution(moves, current_max, count, board, max_moves, current_directions, 
-																current_boards, boards, directions);
-																
+		std::vector<std::vector<Move> > directions;
+		std::vector<Move> path;
+		one_solution(moves, current_max, count, board, max_moves, path, directions);
+
 		//find the shortest pathway index
 		for (int i = 0; i < directions.size(); ++i) {
 			if (current_size == 0) {
@@ -725,11 +625,14 @@ int main(int argc, char* argv[]) {
 				std::cout << "no solutions"<< std::endl;
 		}
 		else {
-				//print out our directions + boards
-				boards[printer][0].print();
+			//replay our directions, printing the boards along the way
+			Board replay = board;
+			replay.print();
 			for (int p = 0; p < directions[printer].size(); ++p) {
-				std::cout << directions[printer][p] << std::endl;
-				boards[printer][p+1].print();
+				const Move &m = directions[printer][p];
+				replay.moveRobot(m.robot, (Direction)m.dir);
+				std::cout << makeStr(COMPASS_NAMES[m.dir], replay.getRobot(m.robot)) << std::endl;
+				replay.print();
 			}
 			std::cout << "All goals are satisfied after " << directions[printer].size() << " moves";
 		}
@@ -738,18 +641,42 @@ int main(int argc, char* argv[]) {
 	//===================================================================
 	//again, all solutions runs almost in the same manner as one_solution
 	//===================================================================
+	else if (all_solutions == true && use_dfs == false) {
+		//count the shortest solutions on the layered graph, then print
+		//them one at a time without ever holding them all
+		ShortestPathDag dag(board, max_moves);
+		board.print();
+		std::vector<Move> first;
+		if (!dag.solvable()) {
+			if (have_max_moves == true) 
+				std::cout << "no solutions with " << max_moves << " or fewer moves" << std::endl;
+			else
+				std::cout << "no solutions"<< std::endl;
+		}
+		else {
+			int min = dag.minMoves();
+			std::cout << dag.numSolutions() << " different " << min << " move solutions:" << std::endl << std::endl;
+			dag.enumerate([&](const std::vector<Move> &solution) {
+				if (first.empty())
+					first = solution;
+				for (int k = 0; k < solution.size(); ++k)
+					std::cout << makeStr(COMPASS_NAMES[solution[k].dir], board.getRobot(solution[k].robot)) << std::endl;
+				std::cout << "All goals are satisfied after " << min << " moves" << std::endl << std::endl;
+			});
+		}
+		//the first solution is a shortest one, so a later single
+		//solution run of this puzzle can use it
+		if (cache_file != "")
+			cache.store(board, max_moves, dag.solvable(), first);
+	}
+
 	else if (all_solutions == true) {
 		int count = 0;
-		int printer;
 		int moves = 0;
 		int current_max = 100;
-		std::vector<std::vector< std::string> > directions;
-		std::vector<std::vector<Board> > boards;
-		std::vector<std::string> current_directions;
-		std::vector<Board> current_boards;
-		current_boards.push_back(board);
-		all_answer(moves, current_max, count, board, max_moves, current_directions, 
-															current_boards, boards, directions);
+		std::vector<std::vector<Move> > directions;
+		std::vector<Move> path;
+		all_answer(moves, current_max, count, board, max_moves, path, directions);
 
 		if (directions.size() == 0) {
 			board.print();
@@ -780,7 +707,8 @@ int main(int argc, char* argv[]) {
 			for (int n = 0; n < directions.size(); ++n) {
 				if (directions[n].size() == min) {
 					for (int k = 0; k < directions[n].size(); ++k) {
-							std::cout << directions[n][k] << std::endl;
+							const Move &m = directions[n][k];
+							std::cout << makeStr(COMPASS_NAMES[m.dir], board.getRobot(m.robot)) << std::endl;
 					}
 					std::cout << "All goals are satisfied after " << min << " moves" << std::endl;
 				}
@@ -0,0 +1,155 @@
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <cctype>
+
+#include "puzzle.h"
+#include "trace.h"
+
+
+// true if x is a whole number plus one half
+static bool isHalf(double x) {
+  return fabs((x - floor(x)) - 0.5) < 0.005;
+}
+
+// a robot label is a capital letter
+static bool isRobotLabel(const std::string &label) {
+  return label.size() == 1 && isalpha(label[0]) && isupper(label[0]);
+}
+
+bool readPuzzle(std::istream &istr, Board &board, std::string &error, LayoutCache *cache) {
+  TraceSpan span("load");
+
+  // read in the board dimensions and create an empty board
+  // (all outer edges are automatically set to be walls, and each row
+  //  and column of walls must fit in a 64 bit mask)
+  int rows,cols;
+  if (!(istr >> rows >> cols) || rows <= 0 || cols <= 0 || rows >= 63 || cols >= 63) {
+    error = "bad board dimensions";
+    return false;
+  }
+  Board answer(rows,cols);
+
+  // read in the other characteristics of the puzzle board.  everything
+  // the Board would assert on is checked here first, so a bad puzzle
+  // is reported rather than ending the program.
+  std::string token;
+  while (istr >> token) {
+    std::ostringstream where;
+    if (token == "robot") {
+      std::string a;
+      int r,c;
+      if (!(istr >> a >> r >> c)) {
+        error = "bad robot line";
+        return false;
+      }
+      where << "robot " << a << " " << r << " " << c;
+      if (!isRobotLabel(a)) {
+        error = where.str() + ": a robot must be a capital letter";
+        return false;
+      }
+      if (r < 1 || r > rows || c < 1 || c > cols) {
+        error = where.str() + ": outside the board";
+        return false;
+      }
+      for (unsigned int i = 0; i < answer.numRobots(); i++) {
+        if (answer.getRobot(i) == a[0]) {
+          error = where.str() + ": there is already a robot " + a;
+          return false;
+        }
+        if (answer.getRobotPosition(i) == Position(r,c)) {
+          error = where.str() + ": there is already a robot on that cell";
+          return false;
+        }
+      }
+      if ((int)answer.numRobots() == MAX_ROBOTS) {
+        where << ": a puzzle may have at most " << MAX_ROBOTS << " robots";
+        error = where.str();
+        return false;
+      }
+      answer.placeRobot(Position(r,c),a[0]);
+    } else if (token == "vertical_wall") {
+      int i;
+      double j;
+      if (!(istr >> i >> j)) {
+        error = "bad vertical_wall line";
+        return false;
+      }
+      where << "vertical_wall " << i << " " << j;
+      // an interior wall, between two columns of row i
+      if (i < 1 || i > rows || !isHalf(j) || j < 1 || j > cols) {
+        error = where.str() + ": not between two cells of the board";
+        return false;
+      }
+      if (answer.getVerticalWall(i,j)) {
+        error = where.str() + ": that wall is already there";
+        return false;
+      }
+      answer.addVerticalWall(i,j);
+    } else if (token == "horizontal_wall") {
+      double i;
+      int j;
+      if (!(istr >> i >> j)) {
+        error = "bad horizontal_wall line";
+        return false;
+      }
+      where << "horizontal_wall " << i << " " << j;
+      if (j < 1 || j > cols || !isHalf(i) || i < 1 || i > rows) {
+        error = where.str() + ": not between two cells of the board";
+        return false;
+      }
+      if (answer.getHorizontalWall(i,j)) {
+        error = where.str() + ": that wall is already there";
+        return false;
+      }
+      answer.addHorizontalWall(i,j);
+    } else if (token == "goal") {
+      std::string which_robot;
+      int r,c;
+      if (!(istr >> which_robot >> r >> c)) {
+        error = "bad goal line";
+        return false;
+      }
+      where << "goal " << which_robot << " " << r << " " << c;
+      if (which_robot != "any") {
+        bool found = false;
+        for (unsigned int i = 0; i < answer.numRobots(); i++)
+          if (isRobotLabel(which_robot) && answer.getRobot(i) == which_robot[0]) found = true;
+        if (!found) {
+          error = where.str() + ": a goal must name a robot placed before it, or any";
+          return false;
+        }
+      }
+      if (r < 1 || r > rows || c < 1 || c > cols) {
+        error = where.str() + ": outside the board";
+        return false;
+      }
+      if (answer.getGeometry().isGoal(Position(r,c)) != ' ') {
+        error = where.str() + ": there is already a goal on that cell";
+        return false;
+      }
+      if (answer.numGoals() == 64) {
+        error = where.str() + ": a puzzle may have at most 64 goals";
+        return false;
+      }
+      answer.addGoal(which_robot,Position(r,c));
+    } else {
+      error = "unknown token in the input file " + token;
+      return false;
+    }
+  }
+
+  // the walls are final now, so attach the tables derived from them
+  answer.buildLayoutTables(cache);
+  board = answer;
+  return true;
+}
+
+bool readPuzzleFile(const std::string &filename, Board &board, std::string &error, LayoutCache *cache) {
+  std::ifstream istr (filename.c_str());
+  if (!istr) {
+    error = "could not open " + filename + " for reading";
+    return false;
+  }
+  return readPuzzle(istr,board,error,cache);
+}
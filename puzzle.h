@@ -0,0 +1,29 @@
+#ifndef _PUZZLE_H_
+#define _PUZZLE_H_
+
+#include <iostream>
+#include <string>
+
+#include "board.h"
+
+
+// ==================================================================
+// ==================================================================
+// Reading a puzzle in the text format of puzzle1.txt: the dimensions,
+// then any number of robot, vertical_wall, horizontal_wall and goal
+// lines.  The board returned has its layout tables built and is ready
+// to solve.  Returns false, with a message in error, if the text does
+// not describe a puzzle: a line that does not parse, a robot, wall or
+// goal off the board, two robots (or goals) on one cell, a repeated
+// robot label or wall, a goal for a robot not yet placed, or more than
+// MAX_ROBOTS robots.  No input makes it assert.  Given a cache, the
+// tables derived from the walls are shared with every other puzzle
+// with the same layout.
+
+bool readPuzzle(std::istream &istr, Board &board, std::string &error, LayoutCache *cache = NULL);
+
+// the same, reading the named file
+bool readPuzzleFile(const std::string &filename, Board &board, std::string &error,
+                    LayoutCache *cache = NULL);
+
+#endif
@@ -0,0 +1,299 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+
+#include "board.h"
+#include "solver.h"
+#include "puzzle.h"
+
+// ./regression [-robot <path>] [-iterations N] [-budget_scale X] [-only <substring>]
+//
+// Runs the robot program (./robot unless -robot says otherwise, built
+// from the current sources) on the shipped puzzles in every mode and
+// compares what it prints with the expected outputs shipped beside
+// them (puzzle1_one_solution.txt, puzzle1_all_solutions.txt, ...).
+// The comparison is by meaning, not by text:
+//
+//   one solution    same number of moves, and the moves printed really
+//                   solve the puzzle (any shortest solution will do)
+//   all solutions   same count and length, and the same set of move
+//                   sequences in any order
+//   no solutions    the same "no solutions ..." line
+//   visualize       same robot and the same grid of move counts
+//
+// Each case also has a runtime budget.  It runs -iterations times
+// (default 3) and its fastest run must be within the budget times
+// -budget_scale (default 1, raise it on a slow machine).  One line is
+// printed per case with the time taken; the exit status is 1 if any
+// case diverged or went over budget, so it can gate a change to the
+// solvers.
+
+// ==================================================================================
+// ==================================================================================
+
+void usage(const std::string &executable_name) {
+  std::cerr << "Usage: " << executable_name << " [-robot <path>] [-iterations <#>] [-budget_scale <x>]"
+            << " [-only <substring>]" << std::endl;
+  exit(0);
+}
+
+class Settings {
+public:
+  Settings() : robot("./robot"), iterations(3), budget_scale(1.0) {}
+  std::string robot;
+  int iterations;
+  double budget_scale;
+  std::string only;
+};
+
+// one run of the robot program, and the expected output to hold it to
+class Case {
+public:
+  Case(const std::string &p, const std::string &a, const std::string &e, double b)
+    : puzzle(p), args(a), expected(e), budget_ms(b) {}
+  std::string puzzle;
+  std::string args;
+  std::string expected;
+  double budget_ms;
+};
+
+// Every mode that is meant to reproduce each expected output.  The
+// original recursive search (-dfs) is only held to the outputs it
+// reproduces with a cap on the moves, and IDA* (-ida, which needs the
+// cap) only to the shallow puzzles it solves within a normal budget.
+std::vector<Case> allCases() {
+  std::vector<Case> cases;
+  cases.push_back(Case("puzzle1.txt", "", "puzzle1_one_solution.txt", 250));
+  cases.push_back(Case("puzzle1.txt", "-max_moves 8 -ida", "puzzle1_one_solution.txt", 250));
+  cases.push_back(Case("puzzle1.txt", "-threads 4", "puzzle1_one_solution.txt", 250));
+  cases.push_back(Case("puzzle1.txt", "-symmetry", "puzzle1_one_solution.txt", 250));
+  cases.push_back(Case("puzzle1.txt", "-dfs -max_moves 8", "puzzle1_one_solution.txt", 250));
+  cases.push_back(Case("puzzle3.txt", "", "puzzle3_one_solution.txt", 500));
+  cases.push_back(Case("puzzle3.txt", "-threads 4", "puzzle3_one_solution.txt", 500));
+  cases.push_back(Case("puzzle1.txt", "-all_solutions", "puzzle1_all_solutions.txt", 250));
+  cases.push_back(Case("puzzle1.txt", "-all_solutions -dfs -max_moves 6", "puzzle1_all_solutions.txt", 250));
+  cases.push_back(Case("puzzle2.txt", "-all_solutions", "puzzle2_all_solutions.txt", 250));
+  cases.push_back(Case("puzzle2.txt", "-all_solutions -dfs -max_moves 6", "puzzle2_all_solutions.txt", 250));
+  cases.push_back(Case("puzzle2.txt", "-max_moves 4", "puzzle2_no_4_move_solutions.txt", 250));
+  cases.push_back(Case("puzzle2.txt", "-max_moves 4 -ida", "puzzle2_no_4_move_solutions.txt", 250));
+  cases.push_back(Case("puzzle2.txt", "-max_moves 4 -dfs", "puzzle2_no_4_move_solutions.txt", 250));
+  cases.push_back(Case("puzzle2.txt", "-max_moves 4 -threads 4", "puzzle2_no_4_move_solutions.txt", 250));
+  cases.push_back(Case("puzzle1.txt", "-visualize A", "puzzle1_reachable_A.txt", 250));
+  cases.push_back(Case("puzzle1.txt", "-visualize A -max_moves 3", "puzzle1_reachable_A_3.txt", 250));
+  cases.push_back(Case("puzzle1.txt", "-visualize B -max_moves 3", "puzzle1_reachable_B_3.txt", 250));
+  cases.push_back(Case("puzzle1.txt", "-visualize C -max_moves 3", "puzzle1_reachable_C_3.txt", 250));
+  return cases;
+}
+
+// ==================================================================================
+// ==================================================================================
+// What an output says, with the printed boards left out.
+
+class Outcome {
+public:
+  Outcome() : num_moves(-1), num_solutions(-1), robot(' ') {}
+  // every "robot X moves dir" line, one list per solution
+  std::vector<std::vector<std::string> > solutions;
+  // the length given by the last "All goals are satisfied" line
+  int num_moves;
+  // the count given by "N different M move solutions:", if any
+  int num_solutions;
+  // the "no solutions ..." line, if any
+  std::string no_solutions;
+  // the visualize grid, if any
+  char robot;
+  std::vector<std::vector<int> > grid;
+};
+
+Outcome parseOutput(std::istream &istr) {
+  Outcome answer;
+  std::vector<std::string> moves;
+  bool in_grid = false;
+  std::string line;
+  while (std::getline(istr,line)) {
+    std::istringstream ss(line);
+    std::string word;
+    if (!(ss >> word)) continue;
+    if (word == "robot") {
+      moves.push_back(line);
+      in_grid = false;
+    } else if (word == "All") {
+      // "All goals are satisfied after N moves"
+      std::string goals, are, satisfied, after;
+      ss >> goals >> are >> satisfied >> after >> answer.num_moves;
+      answer.solutions.push_back(moves);
+      moves.clear();
+    } else if (word == "no") {
+      answer.no_solutions = line;
+    } else if (word == "Reachable") {
+      // "Reachable by robot X:"
+      std::string by, robot;
+      ss >> by >> robot;
+      answer.robot = robot[0];
+      in_grid = true;
+    } else if (in_grid) {
+      std::vector<int> row;
+      do {
+        row.push_back(word == "." ? -1 : atoi(word.c_str()));
+      } while (ss >> word);
+      answer.grid.push_back(row);
+    } else if (isdigit(word[0]) && line.find("different") != std::string::npos) {
+      answer.num_solutions = atoi(word.c_str());
+    }
+  }
+  return answer;
+}
+
+// replay the printed moves on a fresh copy of the puzzle, returning
+// an empty string if they solve it or else what went wrong
+std::string replay(const Board &puzzle, const std::vector<std::string> &moves) {
+  Board board = puzzle;
+  for (unsigned int m = 0; m < moves.size(); m++) {
+    // "robot X moves dir"
+    std::istringstream ss(moves[m]);
+    std::string robot, which, verb, dir;
+    ss >> robot >> which >> verb >> dir;
+    int i = 0;
+    while (i < (int)board.numRobots() && board.getRobot(i) != which[0]) i++;
+    int d = 0;
+    while (d < NUM_DIRECTIONS && dir != COMPASS_NAMES[d]) d++;
+    if (i == (int)board.numRobots() || d == NUM_DIRECTIONS)
+      return "cannot read '" + moves[m] + "'";
+    if (!board.moveRobot(i,(Direction)d))
+      return "'" + moves[m] + "' does not move";
+  }
+  if (!board.isSolved()) return "the moves printed do not solve the puzzle";
+  return "";
+}
+
+// compare an output with the expected one, returning an empty string
+// if they agree or else the first difference
+std::string compare(const Board &puzzle, const Outcome &expected, const Outcome &actual) {
+  std::ostringstream diff;
+  if (expected.robot != ' ') {
+    if (actual.robot != expected.robot)
+      diff << "visualized robot " << actual.robot << ", expected " << expected.robot;
+    else if (actual.grid != expected.grid)
+      diff << "reachability grid differs";
+  } else if (expected.no_solutions != "") {
+    if (actual.no_solutions != expected.no_solutions)
+      diff << "expected '" << expected.no_solutions << "'";
+  } else if (actual.num_moves != expected.num_moves) {
+    diff << actual.num_moves << " moves, expected " << expected.num_moves;
+  } else if (expected.num_solutions >= 0) {
+    std::vector<std::vector<std::string> > a = actual.solutions, e = expected.solutions;
+    std::sort(a.begin(),a.end());
+    std::sort(e.begin(),e.end());
+    if (actual.num_solutions != expected.num_solutions)
+      diff << actual.num_solutions << " solutions, expected " << expected.num_solutions;
+    else if (a != e)
+      diff << "the solutions listed differ";
+  } else if (actual.solutions.size() != 1 || (int)actual.solutions[0].size() != actual.num_moves) {
+    diff << "expected one solution of " << expected.num_moves << " moves";
+  } else {
+    return replay(puzzle,actual.solutions[0]);
+  }
+  return diff.str();
+}
+
+// ==================================================================================
+// ==================================================================================
+
+// run the robot program once, collecting what it prints
+bool runRobot(const std::string &command, std::string &output, double &ms) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  FILE *pipe = popen(command.c_str(),"r");
+  if (pipe == NULL) return false;
+  output.clear();
+  char buffer[4096];
+  size_t n;
+  while ((n = fread(buffer,1,sizeof(buffer),pipe)) > 0) output.append(buffer,n);
+  int status = pclose(pipe);
+  std::chrono::duration<double,std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  ms = elapsed.count();
+  return status == 0;
+}
+
+// run one case, printing a line for it; returns true if it passed
+bool runCase(const Case &c, const Settings &settings) {
+  std::string name = c.puzzle + (c.args == "" ? "" : " " + c.args);
+  std::string error;
+  Board puzzle(1,1);
+  if (!readPuzzleFile(c.puzzle,puzzle,error)) {
+    std::cout << "FAIL  " << name << ": " << error << std::endl;
+    return false;
+  }
+  std::ifstream expected_file(c.expected.c_str());
+  if (!expected_file.good()) {
+    std::cout << "FAIL  " << name << ": cannot open " << c.expected << std::endl;
+    return false;
+  }
+  Outcome expected = parseOutput(expected_file);
+
+  std::string command = settings.robot + " " + c.puzzle + (c.args == "" ? "" : " " + c.args);
+  double best_ms = 0;
+  for (int i = 0; i < settings.iterations; i++) {
+    std::string output;
+    double ms;
+    if (!runRobot(command,output,ms)) {
+      std::cout << "FAIL  " << name << ": '" << command << "' did not run" << std::endl;
+      return false;
+    }
+    std::istringstream ss(output);
+    std::string diff = compare(puzzle,expected,parseOutput(ss));
+    if (diff != "") {
+      std::cout << "FAIL  " << name << ": " << diff << " (" << c.expected << ")" << std::endl;
+      return false;
+    }
+    if (i == 0 || ms < best_ms) best_ms = ms;
+  }
+
+  double budget = c.budget_ms * settings.budget_scale;
+  bool in_budget = (best_ms <= budget);
+  std::cout << (in_budget ? "PASS  " : "SLOW  ") << std::left << std::setw(44) << name
+            << std::right << std::fixed << std::setprecision(1)
+            << std::setw(9) << best_ms << " ms  (budget " << budget << " ms)" << std::endl;
+  return in_budget;
+}
+
+int main(int argc, char* argv[]) {
+  Settings settings;
+  for (int arg = 1; arg < argc; arg++) {
+    std::string flag = argv[arg];
+    if (arg+1 >= argc) usage(argv[0]);
+    if (flag == "-robot") {
+      settings.robot = argv[++arg];
+    } else if (flag == "-iterations") {
+      settings.iterations = atoi(argv[++arg]);
+      if (settings.iterations <= 0) usage(argv[0]);
+    } else if (flag == "-budget_scale") {
+      settings.budget_scale = atof(argv[++arg]);
+      if (settings.budget_scale <= 0) usage(argv[0]);
+    } else if (flag == "-only") {
+      settings.only = argv[++arg];
+    } else {
+      usage(argv[0]);
+    }
+  }
+
+  std::vector<Case> cases = allCases();
+  int run = 0, failed = 0;
+  for (unsigned int i = 0; i < cases.size(); i++) {
+    std::string name = cases[i].puzzle + " " + cases[i].args;
+    if (settings.only != "" && name.find(settings.only) == std::string::npos &&
+        cases[i].expected.find(settings.only) == std::string::npos)
+      continue;
+    run++;
+    if (!runCase(cases[i],settings)) failed++;
+  }
+  std::cout << run-failed << " of " << run << " cases passed" << std::endl;
+  return failed == 0 ? 0 : 1;
+}
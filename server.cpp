@@ -0,0 +1,163 @@
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+
+#include "server.h"
+#include "puzzle.h"
+#include "stats.h"
+
+
+// set by SIGINT/SIGTERM.  the handlers are installed without
+// SA_RESTART, so a blocked read or accept returns and sees it.
+static volatile sig_atomic_t stopping = 0;
+
+static void requestStop(int) { stopping = 1; }
+
+static void installSignalHandlers() {
+  struct sigaction action;
+  memset(&action,0,sizeof(action));
+  action.sa_handler = requestStop;
+  sigaction(SIGINT,&action,NULL);
+  sigaction(SIGTERM,&action,NULL);
+  // a client hanging up mid reply must not kill the server
+  signal(SIGPIPE,SIG_IGN);
+}
+
+static bool writeAll(int fd, const std::string &text) {
+  for (size_t done = 0; done < text.size(); ) {
+    ssize_t n = write(fd,text.data()+done,text.size()-done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    done += n;
+  }
+  return true;
+}
+
+// the reply line to one request.  nothing a client sends may stop the
+// server: readPuzzle rejects every malformed puzzle with a message
+// (it never asserts), and a search too big for memory fails only
+// this request.
+static std::string answer(const std::string &request, const SolveOptions &options, LayoutCache &layouts) {
+  std::istringstream istr(request);
+  Board board(1,1);
+  std::string error;
+  // only IDA* has any use for the shared layout tables
+  if (!readPuzzle(istr,board,error,options.use_ida ? &layouts : NULL))
+    return "ERROR " + error + "\n";
+  try {
+    return solvePuzzle(board,options) + "\n";
+  } catch (const std::bad_alloc &) {
+    return "ERROR out of memory\n";
+  }
+}
+
+// answer the requests arriving on in_fd until it closes.  returns
+// false if the server should shut down.
+static bool serveConnection(int in_fd, int out_fd, const SolveOptions &options,
+                            LayoutCache &layouts, std::vector<double> &latencies) {
+  std::string pending, request;
+  char buffer[4096];
+  while (!stopping) {
+    ssize_t n = read(in_fd,buffer,sizeof(buffer));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return true;
+    pending.append(buffer,n);
+    size_t start = 0;
+    for (size_t eol; (eol = pending.find('\n',start)) != std::string::npos; start = eol+1) {
+      std::string line = pending.substr(start,eol-start);
+      if (!line.empty() && line[line.size()-1] == '\r') line.erase(line.size()-1);
+      if (line == "quit") return false;
+      if (line != "end") {
+        request += line;
+        request += '\n';
+        continue;
+      }
+      std::chrono::steady_clock::time_point received = std::chrono::steady_clock::now();
+      bool sent = writeAll(out_fd,answer(request,options,layouts));
+      std::chrono::duration<double,std::micro> elapsed = std::chrono::steady_clock::now() - received;
+      latencies.push_back(elapsed.count());
+      request.clear();
+      if (!sent) return true;
+    }
+    pending.erase(0,start);
+  }
+  return false;
+}
+
+static void report(std::vector<double> latencies, const LayoutCache &layouts) {
+  std::cerr << latencies.size() << " requests";
+  if (!latencies.empty()) {
+    std::sort(latencies.begin(),latencies.end());
+    std::cerr << ", latency (us) p50 " << percentile(latencies,50)
+              << " p90 " << percentile(latencies,90)
+              << " p99 " << percentile(latencies,99)
+              << " max " << latencies.back();
+  }
+  if (layouts.numMisses() > 0)
+    std::cerr << "; " << layouts.numMisses() << " board layouts, "
+              << layouts.numHits() << " reused";
+  std::cerr << std::endl;
+}
+
+void serve_stdio(const SolveOptions &options) {
+  installSignalHandlers();
+  std::vector<double> latencies;
+  LayoutCache layouts;
+  serveConnection(STDIN_FILENO,STDOUT_FILENO,options,layouts,latencies);
+  report(latencies,layouts);
+}
+
+void serve_socket(const std::string &socket_path, const SolveOptions &options) {
+  struct sockaddr_un address;
+  memset(&address,0,sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    std::cerr << "ERROR: socket path too long " << socket_path << std::endl;
+    return;
+  }
+  strcpy(address.sun_path,socket_path.c_str());
+
+  // replace a socket left by an earlier server, but never anything else
+  struct stat existing;
+  if (lstat(socket_path.c_str(),&existing) == 0) {
+    if (!S_ISSOCK(existing.st_mode)) {
+      std::cerr << "ERROR: could not listen on " << socket_path << ": path exists and is not a socket" << std::endl;
+      return;
+    }
+    unlink(socket_path.c_str());
+  }
+
+  int listener = socket(AF_UNIX,SOCK_STREAM,0);
+  if (listener < 0 ||
+      bind(listener,(struct sockaddr*)&address,sizeof(address)) < 0 ||
+      listen(listener,16) < 0) {
+    std::cerr << "ERROR: could not listen on " << socket_path << ": " << strerror(errno) << std::endl;
+    if (listener >= 0) close(listener);
+    return;
+  }
+
+  installSignalHandlers();
+  std::vector<double> latencies;
+  LayoutCache layouts;
+  while (!stopping) {
+    int connection = accept(listener,NULL,NULL);
+    if (connection < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    bool keep_going = serveConnection(connection,connection,options,layouts,latencies);
+    close(connection);
+    if (!keep_going) break;
+  }
+  close(listener);
+  unlink(socket_path.c_str());
+  report(latencies,layouts);
+}
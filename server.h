@@ -0,0 +1,34 @@
+#ifndef _SERVER_H_
+#define _SERVER_H_
+
+#include <string>
+
+#include "batch.h"
+
+
+// ==================================================================
+// ==================================================================
+// A long running solver.  Each request is a puzzle in the same text
+// format as a puzzle file, followed by a line holding only "end"; the
+// reply is a single line, as in a batch (without the file name):
+//
+//   6 moves: A north, A east, C south, ...
+//   no solutions
+//   ERROR unknown token in the input file ...
+//
+// A line holding only "quit" shuts the server down, as does end of
+// file on stdin, SIGINT or SIGTERM.  On shutdown the request count and
+// latency percentiles (from the "end" line arriving to the reply being
+// written) are printed to stderr.  With -ida, puzzles in one session
+// that share a wall layout share its precomputed tables (see
+// LayoutCache).
+
+// serve requests from stdin, replying on stdout
+void serve_stdio(const SolveOptions &options);
+
+// serve one connection at a time on a Unix domain socket bound to
+// socket_path (an old socket there is replaced; any other file there
+// is left alone and the server does not start)
+void serve_socket(const std::string &socket_path, const SolveOptions &options);
+
+#endif
@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "solution_cache.h"
+
+
+// the first bytes of a cache file (the record layout is versioned by
+// the magic, so an incompatible file is refused rather than misread)
+static const char MAGIC[16] = "RoboRallyCache1";
+
+
+// ==================================================================
+// ==================================================================
+// The canonical puzzle key
+
+
+// two independent 64 bit hashes, fed the same words
+class KeyHasher {
+public:
+  KeyHasher() : a(0x243f6a8885a308d3ULL), b(0x13198a2e03707344ULL) {}
+  void add(uint64_t word) {
+    a = mix(a ^ word);
+    b = mix(b + word * 0x9e3779b97f4a7c15ULL);
+  }
+  StateKey key() const { return StateKey(a,b); }
+private:
+  // one splitmix64 step
+  static uint64_t mix(uint64_t x) { return mix64(x + 0x9e3779b97f4a7c15ULL); }
+  uint64_t a, b;
+};
+
+static StateKey puzzleKey(const Board &board, int max_moves) {
+  const BoardGeometry &geometry = board.getGeometry();
+  KeyHasher hasher;
+  hasher.add(board.getRows());
+  hasher.add(board.getCols());
+  for (int r = 1; r <= board.getRows(); r++) hasher.add(geometry.getRowWalls(r));
+  for (int c = 1; c <= board.getCols(); c++) hasher.add(geometry.getColWalls(c));
+
+  // robots by name and goals by cell, whatever order the file had
+  std::vector<uint64_t> robots, goals;
+  for (unsigned int i = 0; i < board.numRobots(); i++)
+    robots.push_back((uint64_t(board.getRobot(i)) << 32) | geometry.cellIndex(board.getRobotPosition(i)));
+  for (unsigned int k = 0; k < board.numGoals(); k++)
+    goals.push_back((uint64_t(geometry.cellIndex(board.getGoalPosition(k))) << 8) | board.getGoalRobot(k));
+  std::sort(robots.begin(),robots.end());
+  std::sort(goals.begin(),goals.end());
+  hasher.add(robots.size());
+  for (unsigned int i = 0; i < robots.size(); i++) hasher.add(robots[i]);
+  hasher.add(goals.size());
+  for (unsigned int k = 0; k < goals.size(); k++) hasher.add(goals[k]);
+  hasher.add((uint64_t)(int64_t)max_moves);
+  return hasher.key();
+}
+
+
+// ==================================================================
+// ==================================================================
+// Implementation of the SolutionCache class
+
+
+SolutionCache::SolutionCache() : fd(-1) {}
+
+SolutionCache::~SolutionCache() {
+  if (fd >= 0) close(fd);
+}
+
+bool SolutionCache::open(const std::string &filename, std::string &error) {
+  std::lock_guard<std::mutex> guard(lock);
+  fd = ::open(filename.c_str(),O_RDWR | O_CREAT | O_APPEND,0644);
+  if (fd < 0) {
+    error = "could not open " + filename + ": " + strerror(errno);
+    return false;
+  }
+  struct stat info;
+  fstat(fd,&info);
+  if (info.st_size == 0) {
+    // a new cache, give it a header
+    if (write(fd,MAGIC,sizeof(MAGIC)) != (ssize_t)sizeof(MAGIC)) {
+      error = "could not write " + filename;
+      return false;
+    }
+    return true;
+  }
+
+  // map the file and index every whole record after the header
+  size_t length = info.st_size;
+  void *data = mmap(NULL,length,PROT_READ,MAP_PRIVATE,fd,0);
+  if (data == MAP_FAILED) {
+    error = "could not map " + filename + ": " + strerror(errno);
+    return false;
+  }
+  const char *bytes = (const char*)data;
+  if (length < sizeof(MAGIC) || memcmp(bytes,MAGIC,sizeof(MAGIC)) != 0) {
+    munmap(data,length);
+    error = filename + " is not a solution cache";
+    return false;
+  }
+  size_t at = sizeof(MAGIC);
+  for (; at + sizeof(Record) <= length; at += sizeof(Record)) {
+    Record record;
+    memcpy(&record,bytes+at,sizeof(Record));
+    // skip a damaged record, lookup must never read past its moves
+    if (record.num_moves < -1 || record.num_moves > MAX_CACHED_MOVES) continue;
+    entries[StateKey(record.key_lo,record.key_hi)] = record;
+  }
+  munmap(data,length);
+  // drop a record left half written by a crash, so appends stay aligned
+  if (at != length && ftruncate(fd,at) != 0) {
+    error = "could not repair " + filename;
+    return false;
+  }
+  return true;
+}
+
+unsigned long SolutionCache::size() {
+  std::lock_guard<std::mutex> guard(lock);
+  return entries.size();
+}
+
+bool SolutionCache::lookup(const Board &board, int max_moves, bool &solved, std::vector<Move> &moves) {
+  StateKey key = puzzleKey(board,max_moves);
+  Record record;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    std::unordered_map<StateKey,Record,StateKeyHash>::const_iterator itr = entries.find(key);
+    if (itr == entries.end()) return false;
+    record = itr->second;
+  }
+  solved = (record.num_moves >= 0);
+  moves.clear();
+  for (int k = 0; k < record.num_moves; k++) {
+    char which = 'A' + (record.moves[k] >> 2);
+    unsigned int robot = 0;
+    while (robot < board.numRobots() && board.getRobot(robot) != which) robot++;
+    // a hash collision with some other puzzle, treat it as a miss
+    if (robot == board.numRobots()) return false;
+    moves.push_back(Move(robot,record.moves[k] & 3));
+  }
+  return true;
+}
+
+void SolutionCache::store(const Board &board, int max_moves, bool solved, const std::vector<Move> &moves) {
+  if (solved && moves.size() > (unsigned int)MAX_CACHED_MOVES) return;
+  Record record;
+  memset(&record,0,sizeof(record));
+  StateKey key = puzzleKey(board,max_moves);
+  record.key_lo = key.lo;
+  record.key_hi = key.hi;
+  record.num_moves = solved ? moves.size() : -1;
+  for (unsigned int k = 0; solved && k < moves.size(); k++)
+    record.moves[k] = ((board.getRobot(moves[k].robot) - 'A') << 2) | moves[k].dir;
+
+  std::lock_guard<std::mutex> guard(lock);
+  entries[key] = record;
+  // O_APPEND keeps every record whole and in place, even with other
+  // processes appending to the same file
+  if (fd >= 0 && write(fd,&record,sizeof(record)) != (ssize_t)sizeof(record)) {
+    close(fd);
+    fd = -1;
+  }
+}
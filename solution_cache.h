@@ -0,0 +1,78 @@
+#ifndef _SOLUTION_CACHE_H_
+#define _SOLUTION_CACHE_H_
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+
+#include "board.h"
+#include "solver.h"
+
+
+// ==================================================================
+// ==================================================================
+// A persistent cache of solved puzzles, so a repeated query costs one
+// lookup instead of a search.  The key is a 128 bit hash of the
+// puzzle in a canonical form (dimensions, walls, robots by name, goals
+// by cell) and the move cap, so the order of the lines in a puzzle
+// file does not matter.  Each entry holds the moves of one shortest
+// solution (by robot name) or the fact that there is none.  Only the
+// single solution searches (the default mode, -batch and -serve) read
+// it; -all_solutions adds the first solution it prints, and
+// -visualize and -dfs leave it alone.
+//
+// The file is a small header followed by fixed size records, only
+// ever appended to, so it can be read (or mmap'ed) in one pass; a
+// later record for the same key replaces an earlier one.  Safe to use
+// from many threads.
+
+class SolutionCache {
+public:
+
+  // CONSTRUCTOR & DESTRUCTOR
+  SolutionCache();
+  ~SolutionCache();
+
+  // read the entries already in the file, creating it if needed (a
+  // damaged record is ignored, a torn one at the end cut off).
+  // returns false, with a message in error, if it is not a cache file.
+  bool open(const std::string &filename, std::string &error);
+
+  // ACCESSORS
+  // the moves are returned as indices of this board's robots.  returns
+  // false if the puzzle has not been seen.
+  bool lookup(const Board &board, int max_moves, bool &solved, std::vector<Move> &moves);
+  unsigned long size();
+
+  // MODIFIER
+  // record a result (solutions too long for a record are not kept)
+  void store(const Board &board, int max_moves, bool solved, const std::vector<Move> &moves);
+
+  // the longest solution a record can hold
+  static const int MAX_CACHED_MOVES = 48;
+
+private:
+  // disallow copying
+  SolutionCache(const SolutionCache&);
+  SolutionCache& operator=(const SolutionCache&);
+
+  // one record as laid out in the file.  each move is a byte holding
+  // (robot letter - 'A') << 2 | direction.
+  class Record {
+  public:
+    uint64_t key_lo;
+    uint64_t key_hi;
+    // -1 if the puzzle has no solution within the move cap
+    int32_t num_moves;
+    int32_t unused;
+    unsigned char moves[MAX_CACHED_MOVES];
+  };
+
+  // REPRESENTATION
+  std::mutex lock;
+  int fd;
+  std::unordered_map<StateKey,Record,StateKeyHash> entries;
+};
+
+#endif
@@ -0,0 +1,608 @@
+#include <unordered_set>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "solver.h"
+#include "concurrent_set.h"
+#include "stats.h"
+#include "trace.h"
+
+const char* DIRECTION_NAMES[NUM_DIRECTIONS] = { "up", "down", "left", "right" };
+const char* COMPASS_NAMES[NUM_DIRECTIONS] = { "north", "south", "west", "east" };
+
+SearchCounters search_counters;
+
+
+// ==================================================================
+// ==================================================================
+// Breadth first search
+
+
+// how each visited state was first reached: the id of the state it
+// was reached from and the move byte taken from there
+class Parent {
+public:
+  Parent(uint32_t p=0, unsigned char m=0) : parent(p), move(m) {}
+  uint32_t parent;
+  unsigned char move;
+};
+
+// the key a search stores for the board
+static StateKey searchKey(const Board &board, bool symmetry) {
+  return symmetry ? board.packCanonicalState() : board.packState();
+}
+
+// walk the parent links back from state 'at' to the start.  with
+// symmetry each move names a robot of the unpacked (relabeled) parent,
+// so replay the moves on the real board, finding the robot that stands
+// where the parent's mover stood.
+static void tracePath(const Board &board, const std::vector<StateKey> &states,
+                      const std::vector<Parent> &parents, uint32_t at, bool symmetry,
+                      std::vector<Move> &moves) {
+  TraceSpan span("reconstruct");
+  std::vector<uint32_t> ids;
+  for (; at != 0; at = parents[at].parent) {
+    moves.push_back(Move::fromByte(parents[at].move));
+    ids.push_back(parents[at].parent);
+  }
+  std::reverse(moves.begin(),moves.end());
+  std::reverse(ids.begin(),ids.end());
+  if (!symmetry) return;
+  Board real = board;
+  Board parent = board;
+  for (unsigned int k = 0; k < moves.size(); k++) {
+    parent.unpackState(states[ids[k]]);
+    Position from = parent.getRobotPosition(moves[k].robot);
+    unsigned int r = 0;
+    while (real.getRobotPosition(r) != from) r++;
+    moves[k].robot = r;
+    real.moveRobot(r,(Direction)moves[k].dir);
+  }
+}
+
+bool bfs_solve(const Board &board, int max_moves, std::vector<Move> &moves, bool symmetry) {
+  moves.clear();
+  if (board.isSolved()) return true;
+
+  // every state seen gets the next id, so each layer of the search is
+  // a contiguous range of ids and needs no queue of its own
+  std::vector<StateKey> states(1,searchKey(board,symmetry));
+  std::vector<Parent> parents(1);
+  std::unordered_map<StateKey,uint32_t,StateKeyHash> visited;
+  visited[states[0]] = 0;
+
+  // expand one whole level of the search at a time, so the first
+  // solution seen is at the smallest depth
+  Board current = board;
+  unsigned long long expanded = 0, generated = 0;
+  uint32_t begin = 0;
+  for (int depth = 0; max_moves < 0 || depth < max_moves; depth++) {
+    TraceSpan span("depth",depth);
+    uint32_t end = states.size();
+    search_counters.beginLayer(depth,end-begin,states.size());
+    for (uint32_t id = begin; id < end; id++) {
+      current.unpackState(states[id]);
+      if (++expanded == SearchCounters::FLUSH_EVERY) search_counters.flush(expanded,generated);
+      STAT(search_stats.expand(depth));
+      for (unsigned int i = 0; i < current.numRobots(); i++) {
+        for (int d = 0; d < NUM_DIRECTIONS; d++) {
+          UndoToken undo = current.applyMove(i,(Direction)d);
+          if (!undo.moved) continue;
+          generated++;
+          STAT(search_stats.generate(depth+1));
+          StateKey key = searchKey(current,symmetry);
+          bool fresh = visited.insert(std::make_pair(key,(uint32_t)states.size())).second;
+          bool solved = fresh && current.isSolved(i);
+          current.undoMove(undo);
+          if (!fresh) {
+            STAT(search_stats.duplicate());
+            continue;
+          }
+          states.push_back(key);
+          parents.push_back(Parent(id,Move(i,d).toByte()));
+          if (solved) {
+            search_counters.flush(expanded,generated);
+            tracePath(board,states,parents,states.size()-1,symmetry,moves);
+            return true;
+          }
+        }
+      }
+    }
+    search_counters.flush(expanded,generated);
+    // every reachable state has been seen
+    if (end == states.size()) break;
+    begin = end;
+  }
+  return false;
+}
+
+
+// ==================================================================
+// ==================================================================
+// Parallel breadth first search
+
+
+// the number of frontier states a thread claims at a time
+static const uint32_t CHUNK_SIZE = 256;
+
+// a child generated while a layer is being expanded.  the payload is
+// ((parent id + 1) << 8 | move byte): the smallest payload for a state
+// is the parent and move the serial search would have reached it by
+// first, and the start state's payload of 0 is smaller than them all.
+class Candidate {
+public:
+  Candidate(const StateKey &k, uint64_t p, bool s) : key(k), payload(p), solved(s), first(false) {}
+  StateKey key;
+  uint64_t payload;
+  bool solved;
+  // true if this is the first (serial order) time the state was seen
+  bool first;
+};
+
+// a reusable barrier: every one of the count threads waits in
+// arriveAndWait until the last of them arrives
+class Barrier {
+public:
+  Barrier(int n) : count(n), waiting(0), generation(0) {}
+  void arriveAndWait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    unsigned long arrived_in = generation;
+    if (++waiting == count) {
+      waiting = 0;
+      generation++;
+      released.notify_all();
+      return;
+    }
+    released.wait(lock,[&] { return generation != arrived_in; });
+  }
+private:
+  int count;
+  int waiting;
+  unsigned long generation;
+  std::mutex mutex;
+  std::condition_variable released;
+};
+
+// the helper threads of one search, started once and kept for all of
+// its layers.  forEachChunk runs work(chunk) for every chunk, with the
+// caller and the helpers claiming the next unclaimed chunk until none
+// are left; between phases the helpers wait at the barrier.
+class WorkerPool {
+public:
+  WorkerPool(int num_threads) : barrier(num_threads), stopping(false) {
+    for (int t = 1; t < num_threads; t++)
+      helpers.push_back(std::thread(&WorkerPool::help,this,t));
+  }
+  ~WorkerPool() {
+    stopping = true;
+    barrier.arriveAndWait();
+    for (unsigned int t = 0; t < helpers.size(); t++)
+      helpers[t].join();
+  }
+
+  void forEachChunk(const char* p, uint32_t n, const std::function<void(uint32_t)> &w) {
+    // published to the helpers by the barrier
+    phase = p;
+    num_chunks = n;
+    work = &w;
+    next_chunk = 0;
+    barrier.arriveAndWait();
+    claimChunks();
+    barrier.arriveAndWait();
+  }
+
+private:
+  // disallow copying
+  WorkerPool(const WorkerPool&);
+  WorkerPool& operator=(const WorkerPool&);
+
+  void help(int t) {
+    // each helper keeps trace lane t for the whole search
+    tracer.setLane(t);
+    while (true) {
+      barrier.arriveAndWait();
+      if (stopping) return;
+      claimChunks();
+      barrier.arriveAndWait();
+    }
+  }
+  void claimChunks() {
+    TraceSpan span(phase);
+    for (uint32_t c = next_chunk++; c < num_chunks; c = next_chunk++)
+      (*work)(c);
+  }
+
+  // REPRESENTATION
+  Barrier barrier;
+  std::vector<std::thread> helpers;
+  bool stopping;
+  // the phase being run
+  const char* phase;
+  uint32_t num_chunks;
+  const std::function<void(uint32_t)> *work;
+  std::atomic<uint32_t> next_chunk;
+};
+
+bool parallel_bfs_solve(const Board &board, int max_moves, int num_threads, std::vector<Move> &moves,
+                        bool symmetry) {
+  if (num_threads <= 1) return bfs_solve(board,max_moves,moves,symmetry);
+  moves.clear();
+  if (board.isSolved()) return true;
+
+  std::vector<StateKey> states(1,searchKey(board,symmetry));
+  std::vector<Parent> parents(1);
+  ConcurrentStateSet visited;
+  visited.insert(states[0],0);
+  WorkerPool pool(num_threads);
+
+  uint32_t begin = 0;
+  for (int depth = 0; max_moves < 0 || depth < max_moves; depth++) {
+    TraceSpan span("depth",depth);
+    uint32_t end = states.size();
+    uint32_t num_chunks = (end - begin + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    search_counters.beginLayer(depth,end-begin,states.size());
+    std::vector<std::vector<Candidate> > buffers(num_chunks);
+
+    // expand: each buffer is written only by the thread that claimed
+    // its chunk, and the visited set is only read
+    pool.forEachChunk("expand",num_chunks,[&](uint32_t c) {
+      Board current = board;
+      unsigned long long expanded = 0, generated = 0;
+      uint32_t last = std::min(end,begin + (c+1)*CHUNK_SIZE);
+      for (uint32_t id = begin + c*CHUNK_SIZE; id < last; id++) {
+        current.unpackState(states[id]);
+        expanded++;
+        STAT(search_stats.expand(depth));
+        for (unsigned int i = 0; i < current.numRobots(); i++) {
+          for (int d = 0; d < NUM_DIRECTIONS; d++) {
+            UndoToken undo = current.applyMove(i,(Direction)d);
+            if (!undo.moved) continue;
+            generated++;
+            STAT(search_stats.generate(depth+1));
+            StateKey key = searchKey(current,symmetry);
+            if (!visited.contains(key)) {
+              uint64_t payload = (uint64_t(id+1) << 8) | Move(i,d).toByte();
+              buffers[c].push_back(Candidate(key,payload,current.isSolved(i)));
+            } else {
+              STAT(search_stats.duplicate());
+            }
+            current.undoMove(undo);
+          }
+        }
+      }
+      search_counters.flush(expanded,generated);
+    });
+
+    // insert every candidate concurrently, the smallest payload wins
+    uint64_t total = 0;
+    for (uint32_t c = 0; c < num_chunks; c++) total += buffers[c].size();
+    visited.reserve(total);
+    pool.forEachChunk("insert",num_chunks,[&](uint32_t c) {
+      for (unsigned int k = 0; k < buffers[c].size(); k++)
+        visited.insert(buffers[c][k].key,buffers[c][k].payload);
+    });
+
+    // the candidates holding the winning payload are the new states;
+    // numbering them in chunk order gives the serial search's ids
+    std::vector<uint32_t> offsets(num_chunks+1,0);
+    pool.forEachChunk("number",num_chunks,[&](uint32_t c) {
+      for (unsigned int k = 0; k < buffers[c].size(); k++) {
+        uint64_t payload;
+        visited.find(buffers[c][k].key,payload);
+        buffers[c][k].first = (payload == buffers[c][k].payload);
+        if (buffers[c][k].first) offsets[c+1]++;
+        else STAT(search_stats.duplicate());
+      }
+    });
+    for (uint32_t c = 0; c < num_chunks; c++) offsets[c+1] += offsets[c];
+    states.resize(end + offsets[num_chunks]);
+    parents.resize(end + offsets[num_chunks]);
+    pool.forEachChunk("place",num_chunks,[&](uint32_t c) {
+      uint32_t id = end + offsets[c];
+      for (unsigned int k = 0; k < buffers[c].size(); k++) {
+        if (!buffers[c][k].first) continue;
+        states[id] = buffers[c][k].key;
+        parents[id] = Parent((buffers[c][k].payload >> 8) - 1,buffers[c][k].payload & 0xff);
+        id++;
+      }
+    });
+
+    // the first solved state in serial order
+    for (uint32_t c = 0; c < num_chunks; c++) {
+      uint32_t id = end + offsets[c];
+      for (unsigned int k = 0; k < buffers[c].size(); k++) {
+        if (!buffers[c][k].first) continue;
+        if (buffers[c][k].solved) {
+          tracePath(board,states,parents,id,symmetry,moves);
+          return true;
+        }
+        id++;
+      }
+    }
+    if (end == states.size()) break;
+    begin = end;
+  }
+  return false;
+}
+
+
+// ==================================================================
+// ==================================================================
+// Reachability
+
+
+std::vector<std::vector<int> > reachability(const Board &board, int robot, int max_moves) {
+  std::vector<std::vector<int> > visual(board.getRows(),std::vector<int>(board.getCols(),-1));
+  Position p = board.getRobotPosition(robot);
+  visual[p.row-1][p.col-1] = 0;
+
+  std::unordered_set<StateKey,StateKeyHash> visited;
+  std::vector<StateKey> frontier(1,board.packState());
+  std::vector<StateKey> next;
+  visited.insert(frontier[0]);
+
+  // the first layer in which the robot stands on a cell is the fewest
+  // moves needed to get it there
+  Board current = board;
+  unsigned long long expanded = 0, generated = 0;
+  for (int depth = 0; max_moves < 0 || depth < max_moves; depth++) {
+    TraceSpan span("depth",depth);
+    next.clear();
+    search_counters.beginLayer(depth,frontier.size(),visited.size());
+    for (unsigned int f = 0; f < frontier.size(); f++) {
+      current.unpackState(frontier[f]);
+      if (++expanded == SearchCounters::FLUSH_EVERY) search_counters.flush(expanded,generated);
+      STAT(search_stats.expand(depth));
+      for (unsigned int i = 0; i < current.numRobots(); i++) {
+        for (int d = 0; d < NUM_DIRECTIONS; d++) {
+          UndoToken undo = current.applyMove(i,(Direction)d);
+          if (!undo.moved) continue;
+          generated++;
+          STAT(search_stats.generate(depth+1));
+          StateKey key = current.packState();
+          p = current.getRobotPosition(robot);
+          current.undoMove(undo);
+          if (!visited.insert(key).second) {
+            STAT(search_stats.duplicate());
+            continue;
+          }
+          next.push_back(key);
+          if (visual[p.row-1][p.col-1] == -1)
+            visual[p.row-1][p.col-1] = depth+1;
+        }
+      }
+    }
+    search_counters.flush(expanded,generated);
+    if (next.empty()) break;
+    frontier.swap(next);
+  }
+  return visual;
+}
+
+
+// ==================================================================
+// ==================================================================
+// Iterative deepening A*
+
+
+std::vector<std::vector<int> > goalDistances(const Board &board) {
+  TraceSpan span("preprocess");
+  const BoardGeometry &geometry = board.getGeometry();
+  std::vector<std::vector<int> > answer;
+  for (unsigned int k = 0; k < board.numGoals(); k++)
+    answer.push_back(geometry.getLayout().distancesTo(geometry.cellIndex(board.getGoalPosition(k))));
+  return answer;
+}
+
+// the largest distance any single goal still needs
+static int lowerBound(const Board &board, const std::vector<std::vector<int> > &dist) {
+  const BoardGeometry &geometry = board.getGeometry();
+  int bound = 0;
+  for (unsigned int k = 0; k < board.numGoals(); k++) {
+    char which = board.getGoalRobot(k);
+    int best = UNREACHABLE;
+    for (unsigned int r = 0; r < board.numRobots(); r++) {
+      if (which == '?' || which == board.getRobot(r))
+        best = std::min(best,dist[k][geometry.cellIndex(board.getRobotPosition(r))]);
+    }
+    bound = std::max(bound,best);
+  }
+  return bound;
+}
+
+// one bounded depth first pass.  returns -1 if a solution was found
+// (left in moves), otherwise the smallest f = g + h that exceeded the
+// bound.  path holds the states on the way here, to skip cycles.
+static int ida_search(Board &board, int g, int bound, const std::vector<std::vector<int> > &dist,
+                      std::vector<StateKey> &path, std::vector<Move> &moves,
+                      unsigned long long &expanded, unsigned long long &generated) {
+  int f = g + lowerBound(board,dist);
+  if (f > bound) return f;
+  if (board.isSolved()) return -1;
+  if (++expanded == SearchCounters::FLUSH_EVERY) search_counters.flush(expanded,generated);
+  STAT(search_stats.expand(g));
+  int next_bound = UNREACHABLE;
+  for (unsigned int i = 0; i < board.numRobots(); i++) {
+    for (int d = 0; d < NUM_DIRECTIONS; d++) {
+      UndoToken undo = board.applyMove(i,(Direction)d);
+      if (!undo.moved) continue;
+      generated++;
+      STAT(search_stats.generate(g+1));
+      StateKey key = board.packState();
+      if (std::find(path.begin(),path.end(),key) != path.end()) {
+        // back on a state already on the path
+        STAT(search_stats.duplicate());
+      } else {
+        path.push_back(key);
+        moves.push_back(Move(i,d));
+        int t = ida_search(board,g+1,bound,dist,path,moves,expanded,generated);
+        if (t == -1) return -1;
+        path.pop_back();
+        moves.pop_back();
+        next_bound = std::min(next_bound,t);
+      }
+      board.undoMove(undo);
+    }
+  }
+  return next_bound;
+}
+
+bool ida_solve(const Board &board, int max_moves, std::vector<Move> &moves) {
+  // without a cap an unsolvable puzzle would deepen forever
+  assert (max_moves >= 0);
+  std::vector<std::vector<int> > dist = goalDistances(board);
+  std::vector<StateKey> path(1,board.packState());
+  int bound = lowerBound(board,dist);
+  // a single board is moved and unmoved all the way down the search
+  Board current = board;
+  unsigned long long expanded = 0, generated = 0;
+  // the states expanded by the last two iterations, to guess the size
+  // of the next one for a progress report
+  unsigned long long last = 0, before_last = 0;
+  while (bound <= max_moves) {
+    TraceSpan span("depth",bound);
+    moves.clear();
+    unsigned long long start = search_counters.expanded.load(std::memory_order_relaxed);
+    unsigned long long estimate = (before_last > 0 ? (unsigned long long)(double(last) * last / before_last) : 0);
+    search_counters.beginLayer(bound,estimate,0);
+    int t = ida_search(current,0,bound,dist,path,moves,expanded,generated);
+    search_counters.flush(expanded,generated);
+    if (t == -1) return true;
+    before_last = last;
+    last = search_counters.expanded.load(std::memory_order_relaxed) - start;
+    bound = t;
+  }
+  moves.clear();
+  return false;
+}
+
+
+// ==================================================================
+// ==================================================================
+// Implementation of the ShortestPathDag class
+
+
+ShortestPathDag::ShortestPathDag(const Board &board, int max_moves)
+  : start(board), min_moves(-1), num_solutions(0) {
+  StateKey key = start.packState();
+  nodes[key] = Node(0);
+  nodes[key].paths = 1;
+  layers.push_back(std::vector<StateKey>(1,key));
+  if (start.isSolved()) {
+    min_moves = 0;
+    num_solutions = 1;
+    collectUseful();
+    return;
+  }
+
+  // grow one layer at a time.  a state first seen in the layer being
+  // built picks up the path counts of every parent in the previous
+  // layer; states seen earlier are not part of any shortest path.
+  Board current = start;
+  unsigned long long expanded = 0, generated = 0;
+  for (int depth = 0; max_moves < 0 || depth < max_moves; depth++) {
+    TraceSpan span("depth",depth);
+    std::vector<StateKey> next;
+    search_counters.beginLayer(depth,layers[depth].size(),nodes.size());
+    for (unsigned int f = 0; f < layers[depth].size(); f++) {
+      current.unpackState(layers[depth][f]);
+      if (++expanded == SearchCounters::FLUSH_EVERY) search_counters.flush(expanded,generated);
+      STAT(search_stats.expand(depth));
+      unsigned long long paths = nodes[layers[depth][f]].paths;
+      for (unsigned int i = 0; i < current.numRobots(); i++) {
+        for (int d = 0; d < NUM_DIRECTIONS; d++) {
+          UndoToken undo = current.applyMove(i,(Direction)d);
+          if (!undo.moved) continue;
+          generated++;
+          STAT(search_stats.generate(depth+1));
+          StateKey child_key = current.packState();
+          std::unordered_map<StateKey,Node,StateKeyHash>::iterator itr = nodes.find(child_key);
+          if (itr == nodes.end()) {
+            itr = nodes.insert(std::make_pair(child_key,Node(depth+1))).first;
+            next.push_back(child_key);
+            if (current.isSolved(i)) min_moves = depth+1;
+          } else {
+            STAT(search_stats.duplicate());
+          }
+          current.undoMove(undo);
+          if (itr->second.depth == depth+1)
+            itr->second.paths += paths;
+        }
+      }
+    }
+    search_counters.flush(expanded,generated);
+    if (next.empty()) break;
+    layers.push_back(next);
+    if (min_moves >= 0) break;
+  }
+  if (min_moves < 0) return;
+
+  // add up the paths into every solved state of the last layer
+  for (unsigned int f = 0; f < layers[min_moves].size(); f++) {
+    current.unpackState(layers[min_moves][f]);
+    if (current.isSolved())
+      num_solutions += nodes[layers[min_moves][f]].paths;
+  }
+  collectUseful();
+}
+
+// mark, from the last layer backwards, the states that lead to a
+// solved state along shortest paths, so enumeration never explores a
+// dead end
+void ShortestPathDag::collectUseful() {
+  TraceSpan span("reconstruct");
+  Board current = start;
+  for (int depth = min_moves; depth >= 0; depth--) {
+    for (unsigned int f = 0; f < layers[depth].size(); f++) {
+      current.unpackState(layers[depth][f]);
+      bool useful = false;
+      if (depth == min_moves) {
+        useful = current.isSolved();
+      } else {
+        for (unsigned int i = 0; i < current.numRobots() && !useful; i++) {
+          for (int d = 0; d < NUM_DIRECTIONS && !useful; d++) {
+            UndoToken undo = current.applyMove(i,(Direction)d);
+            if (!undo.moved) continue;
+            std::unordered_map<StateKey,Node,StateKeyHash>::const_iterator itr = nodes.find(current.packState());
+            current.undoMove(undo);
+            useful = (itr->second.depth == depth+1 && itr->second.useful);
+          }
+        }
+      }
+      nodes[layers[depth][f]].useful = useful;
+    }
+  }
+}
+
+void ShortestPathDag::enumerate(const std::function<void(const std::vector<Move>&)> &visit) const {
+  if (min_moves < 0) return;
+  TraceSpan span("enumerate");
+  std::vector<Move> moves;
+  Board current = start;
+  walk(current,0,moves,visit);
+}
+
+// follow only the edges into useful states of the next layer
+void ShortestPathDag::walk(Board &current, int depth, std::vector<Move> &moves,
+                           const std::function<void(const std::vector<Move>&)> &visit) const {
+  if (depth == min_moves) {
+    visit(moves);
+    return;
+  }
+  for (unsigned int i = 0; i < current.numRobots(); i++) {
+    for (int d = 0; d < NUM_DIRECTIONS; d++) {
+      UndoToken undo = current.applyMove(i,(Direction)d);
+      if (!undo.moved) continue;
+      std::unordered_map<StateKey,Node,StateKeyHash>::const_iterator itr = nodes.find(current.packState());
+      if (itr != nodes.end() && itr->second.depth == depth+1 && itr->second.useful) {
+        moves.push_back(Move(i,d));
+        walk(current,depth+1,moves,visit);
+        moves.pop_back();
+      }
+      current.undoMove(undo);
+    }
+  }
+}
@@ -0,0 +1,184 @@
+#ifndef _SOLVER_H_
+#define _SOLVER_H_
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <unordered_map>
+#include <atomic>
+
+#include "board.h"
+
+
+// ==================================================================
+// ==================================================================
+// The names of the four directions a robot can slide, indexed by
+// Direction (the order the solvers try them).  The first names are
+// the ones the command line uses, the second are the compass names
+// printed in a solution.
+
+const int NUM_DIRECTIONS = 4;
+extern const char* DIRECTION_NAMES[NUM_DIRECTIONS];
+extern const char* COMPASS_NAMES[NUM_DIRECTIONS];
+
+
+// ==================================================================
+// ==================================================================
+// A tiny all-public helper class to record one move of a solution:
+// which robot (its index on the Board) and which way it slid (a
+// Direction).  A move also fits in a single byte, for storing one per
+// visited state.
+
+class Move {
+public:
+  Move(int r=-1, int d=-1) : robot(r), dir(d) {}
+  unsigned char toByte() const { return robot*NUM_DIRECTIONS + dir; }
+  static Move fromByte(unsigned char b) { return Move(b/NUM_DIRECTIONS, b%NUM_DIRECTIONS); }
+  int robot;
+  int dir;
+};
+
+
+// ==================================================================
+// ==================================================================
+// Running totals kept by the search drivers: the states expanded
+// (every move tried from them) and generated (reached by a move that
+// went somewhere, new or not).  The drivers add to them with relaxed
+// atomics at least every FLUSH_EVERY states expanded and at the end of
+// each layer or iteration, so another thread may read them at any
+// time.  They are summed over every search in the process.
+//
+// The drivers also note where they are, for a progress report (see
+// Heartbeat): the depth being expanded (the bound, for IDA*), the
+// number of states in that layer (for IDA*, an estimate from the
+// growth of the previous iterations; 0 if unknown), the states seen so
+// far, and the value of expanded when the layer began.
+
+class SearchCounters {
+public:
+  static const unsigned long long FLUSH_EVERY = 4096;
+
+  SearchCounters() { reset(); }
+  void reset() {
+    expanded = 0; generated = 0;
+    depth = 0; frontier = 0; visited = 0; layer_start = 0;
+  }
+  // add a search's local counts, and zero them
+  void flush(unsigned long long &e, unsigned long long &g) {
+    expanded.fetch_add(e,std::memory_order_relaxed);
+    generated.fetch_add(g,std::memory_order_relaxed);
+    e = g = 0;
+  }
+  // call after flushing the previous layer
+  void beginLayer(int d, unsigned long long f, unsigned long long v) {
+    depth.store(d,std::memory_order_relaxed);
+    frontier.store(f,std::memory_order_relaxed);
+    visited.store(v,std::memory_order_relaxed);
+    layer_start.store(expanded.load(std::memory_order_relaxed),std::memory_order_relaxed);
+  }
+  std::atomic<unsigned long long> expanded;
+  std::atomic<unsigned long long> generated;
+  std::atomic<int> depth;
+  std::atomic<unsigned long long> frontier;
+  std::atomic<unsigned long long> visited;
+  std::atomic<unsigned long long> layer_start;
+};
+
+extern SearchCounters search_counters;
+
+
+// ==================================================================
+// ==================================================================
+// The search drivers.  Each takes the freshly loaded board and a cap
+// on the number of moves (-1 means unlimited).
+
+// Breadth first search over packed robot states, remembering every
+// state already seen.  The first solution found uses the fewest
+// possible moves.  Returns false if there is no solution within
+// max_moves (or at all).
+// With symmetry, boards that differ only by swapping robots that no
+// goal names are treated as one state (see Board::packCanonicalState),
+// which can shrink the search by up to R! when every goal is "any";
+// the moves returned are relabeled to the robots actually on the board.
+bool bfs_solve(const Board &board, int max_moves, std::vector<Move> &moves, bool symmetry = false);
+
+// The same search with each layer expanded by num_threads threads.
+// Threads claim chunks of the layer as they go and write the children
+// they generate into a buffer per chunk, then insert them into a
+// shared lock-free visited set.  Ties are settled the way the serial
+// search would settle them, so the states numbered and the solution
+// found are exactly those of bfs_solve.  The threads are started once
+// per search and meet at a barrier between the phases of each layer.
+bool parallel_bfs_solve(const Board &board, int max_moves, int num_threads, std::vector<Move> &moves,
+                        bool symmetry = false);
+
+// Breadth first search over every state reachable from the board (up
+// to max_moves deep, or unlimited if -1), recording the fewest moves
+// after which the given robot stands on each cell.  Cells the robot
+// can never reach are -1.  Indexed [row-1][col-1].
+std::vector<std::vector<int> > reachability(const Board &board, int robot, int max_moves);
+
+// For each goal, the fewest moves a lone robot needs from each cell to
+// reach it if it could stop anywhere along a slide (only walls are
+// considered).  This never overestimates, since other robots can only
+// ever provide extra places to stop.  Indexed [goal][cell].
+std::vector<std::vector<int> > goalDistances(const Board &board);
+
+// Iterative deepening A*: depth first searches bounded by moves made
+// plus the goal distance lower bound, raising the bound until a
+// solution appears.  Memory is proportional to the depth only.  The
+// solution found uses the fewest possible moves.
+// IDA* keeps no visited set, so it cannot tell an unsolvable puzzle
+// from a long one: max_moves is required (it must not be -1), and
+// bounds above it are pruned.
+bool ida_solve(const Board &board, int max_moves, std::vector<Move> &moves);
+
+
+// ==================================================================
+// ==================================================================
+// The layered graph of every shortest solution.  The constructor runs
+// a breadth first search until the first layer containing a solved
+// state (or max_moves, or until nothing new is reachable), counting
+// for every state the number of shortest move sequences that reach it.
+// Solutions are never stored: the count comes from that dynamic
+// programming and the move sequences are regenerated one at a time on
+// request.  Memory is proportional to the number of states.
+
+class ShortestPathDag {
+public:
+  ShortestPathDag(const Board &board, int max_moves);
+
+  // ACCESSORS
+  bool solvable() const { return min_moves >= 0; }
+  int minMoves() const { return min_moves; }
+  unsigned long long numSolutions() const { return num_solutions; }
+
+  // call visit once for every solution with the fewest moves
+  void enumerate(const std::function<void(const std::vector<Move>&)> &visit) const;
+
+private:
+  // private helper functions
+  void collectUseful();
+  void walk(Board &current, int depth, std::vector<Move> &moves,
+            const std::function<void(const std::vector<Move>&)> &visit) const;
+
+  // what is known about each state reached
+  class Node {
+  public:
+    Node(int d=0) : depth(d), paths(0), useful(false) {}
+    int depth;
+    // the number of shortest move sequences from the start to here
+    unsigned long long paths;
+    // true if some shortest solution passes through here
+    bool useful;
+  };
+
+  // REPRESENTATION
+  Board start;
+  int min_moves;
+  unsigned long long num_solutions;
+  std::unordered_map<StateKey,Node,StateKeyHash> nodes;
+  std::vector<std::vector<StateKey> > layers;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+
+#include "stats.h"
+
+SearchStats search_stats;
+
+double percentile(const std::vector<double> &sorted, double p) {
+  int rank = (int)std::ceil(p / 100.0 * sorted.size());
+  return sorted[std::max(rank,1)-1];
+}
+
+
+// ==================================================================
+// ==================================================================
+// Implementation of the SearchStats class
+
+
+void SearchStats::reset() {
+  for (int d = 0; d < MAX_DEPTH; d++) {
+    expanded[d] = 0;
+    generated[d] = 0;
+  }
+  for (int p = 0; p < NUM_PRUNES; p++) prunes[p] = 0;
+  duplicates = 0;
+  checkmove_rejects = 0;
+  slides = 0;
+  slide_cells = 0;
+  std::lock_guard<std::mutex> lock(seen_mutex);
+  seen.clear();
+}
+
+bool SearchStats::enabled() {
+#ifdef ROBOT_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+void SearchStats::visit(const StateKey &key) {
+  std::lock_guard<std::mutex> lock(seen_mutex);
+  if (!seen.insert(key).second) duplicate();
+}
+
+void SearchStats::print(std::ostream &ostr) const {
+  if (!enabled()) {
+    ostr << "stats: not compiled in, rebuild with -DROBOT_STATS" << std::endl;
+    return;
+  }
+  // one line per depth that saw any nodes
+  ostr << "stats:  depth    expanded   generated" << std::endl;
+  for (int d = 0; d < MAX_DEPTH; d++) {
+    if (expanded[d] == 0 && generated[d] == 0) continue;
+    ostr << "stats: " << std::setw(5) << d << (d == MAX_DEPTH-1 ? "+" : " ")
+         << std::setw(11) << expanded[d] << " " << std::setw(11) << generated[d] << std::endl;
+  }
+  ostr << "stats: duplicate states     " << duplicates << std::endl;
+  ostr << "stats: checkmove rejections " << checkmove_rejects << std::endl;
+  const char* names[NUM_PRUNES] = { "checkUp", "checkDown", "checkLeft", "checkRight", "checkLR", "checkUD" };
+  for (int p = 0; p < NUM_PRUNES; p++)
+    ostr << "stats: pruned by " << std::left << std::setw(11) << names[p] << std::right << " " << prunes[p] << std::endl;
+  ostr << "stats: slides               " << slides;
+  if (slides > 0)
+    ostr << " averaging " << std::fixed << std::setprecision(2) << double(slide_cells) / slides << " cells";
+  ostr << std::endl;
+}
@@ -0,0 +1,81 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <unordered_set>
+#include <vector>
+
+#include "board.h"
+
+
+// ==================================================================
+// ==================================================================
+// Detailed counters for finding out why a search blows up, printed by
+// the -stats flag.  They are only compiled in when the program is
+// built with -DROBOT_STATS: otherwise every STAT(...) expands to
+// nothing and the moves and searches are exactly as fast as before.
+//
+//   STAT(search_stats.expand(depth));
+
+#ifdef ROBOT_STATS
+#define STAT(statement) do { statement; } while (0)
+#else
+#define STAT(statement) do { } while (0)
+#endif
+
+class SearchStats {
+public:
+  // nodes deeper than this are counted in the last depth
+  static const int MAX_DEPTH = 64;
+  // the oscillation filters, in the order they are printed
+  enum Prune { PRUNE_UP, PRUNE_DOWN, PRUNE_LEFT, PRUNE_RIGHT, PRUNE_LR, PRUNE_UD, NUM_PRUNES };
+
+  SearchStats() { reset(); }
+  void reset();
+
+  // true if this build was compiled with ROBOT_STATS
+  static bool enabled();
+
+  // MODIFIERS (safe to call from any thread)
+  // a node whose children are about to be tried, and a child made
+  void expand(int depth) { add(expanded[bucket(depth)]); }
+  void generate(int depth) { add(generated[bucket(depth)]); }
+  // a search reached a state it had already reached
+  void duplicate() { add(duplicates); }
+  // for the depth first searches, which keep no visited set of their
+  // own: counts a duplicate if the state was expanded before
+  void visit(const StateKey &key);
+  void checkmoveRejected() { add(checkmove_rejects); }
+  void prune(Prune which) { add(prunes[which]); }
+  // a robot slid this many cells
+  void slide(int length) { add(slides); add(slide_cells,length); }
+
+  void print(std::ostream &ostr) const;
+
+private:
+  static int bucket(int depth) { return depth < MAX_DEPTH ? depth : MAX_DEPTH-1; }
+  static void add(std::atomic<unsigned long long> &counter, unsigned long long n = 1) {
+    counter.fetch_add(n,std::memory_order_relaxed);
+  }
+
+  // REPRESENTATION
+  std::atomic<unsigned long long> expanded[MAX_DEPTH];
+  std::atomic<unsigned long long> generated[MAX_DEPTH];
+  std::atomic<unsigned long long> duplicates;
+  std::atomic<unsigned long long> checkmove_rejects;
+  std::atomic<unsigned long long> prunes[NUM_PRUNES];
+  std::atomic<unsigned long long> slides;
+  std::atomic<unsigned long long> slide_cells;
+  std::mutex seen_mutex;
+  std::unordered_set<StateKey,StateKeyHash> seen;
+};
+
+extern SearchStats search_stats;
+
+// the nearest rank percentile (p from 0 to 100) of values sorted in
+// increasing order, for the latency and timing reports
+double percentile(const std::vector<double> &sorted, double p);
+
+#endif
@@ -0,0 +1,81 @@
+#include <fstream>
+#include <iomanip>
+#include <set>
+
+#include "trace.h"
+
+Tracer tracer;
+
+
+// ==================================================================
+// ==================================================================
+// Implementation of the Tracer class
+
+
+void Tracer::start(const std::string &f, bool per_thread_lanes) {
+  std::lock_guard<std::mutex> lock(mutex);
+  filename = f;
+  per_thread = per_thread_lanes;
+  origin = std::chrono::steady_clock::now();
+  // the thread starting the trace is lane 0
+  lane();
+  on.store(true,std::memory_order_relaxed);
+}
+
+// -1 until the thread is given a lane
+static thread_local int current_lane = -1;
+
+int Tracer::lane() {
+  if (current_lane == -1)
+    current_lane = (enabled() ? next_lane++ : 0);
+  return current_lane;
+}
+
+void Tracer::setLane(int lane) {
+  current_lane = lane;
+}
+
+void Tracer::record(const char* name, int depth, std::chrono::steady_clock::time_point begin,
+                    std::chrono::steady_clock::time_point end) {
+  Event e;
+  e.name = name;
+  e.depth = depth;
+  e.lane = lane();
+  e.start_us = std::chrono::duration<double,std::micro>(begin - origin).count();
+  e.duration_us = std::chrono::duration<double,std::micro>(end - begin).count();
+  std::lock_guard<std::mutex> lock(mutex);
+  events.push_back(e);
+}
+
+bool Tracer::write(std::string &error) {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::ofstream ostr(filename.c_str());
+  if (!ostr.good()) {
+    error = "cannot write trace file " + filename;
+    return false;
+  }
+  ostr << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+  std::set<int> lanes;
+  ostr << std::fixed << std::setprecision(3);
+  for (unsigned int i = 0; i < events.size(); i++) {
+    const Event &e = events[i];
+    int tid = (per_thread ? e.lane : 0);
+    lanes.insert(tid);
+    ostr << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+         << ",\"ts\":" << e.start_us << ",\"dur\":" << e.duration_us;
+    if (e.depth != -1)
+      ostr << ",\"args\":{\"depth\":" << e.depth << "}";
+    ostr << "}," << std::endl;
+  }
+  // name the rows
+  for (std::set<int>::iterator itr = lanes.begin(); itr != lanes.end(); itr++) {
+    ostr << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << *itr
+         << ",\"args\":{\"name\":\"";
+    if (*itr == 0) ostr << (per_thread ? "main" : "all threads");
+    else ostr << "worker " << *itr;
+    ostr << "\"}}," << std::endl;
+  }
+  ostr << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"robot\"}}" << std::endl;
+  ostr << "]}" << std::endl;
+  return true;
+}
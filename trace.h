@@ -0,0 +1,93 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <chrono>
+
+
+// ==================================================================
+// ==================================================================
+// Phase timings in the Chrome trace event format, for loading into
+// chrome://tracing, Perfetto or speedscope.  A TraceSpan times the
+// scope it lives in (loading a puzzle, building the wall tables, one
+// depth of a search, reconstructing a solution, printing a board...)
+// and, if the global tracer has been started, records it as one
+// complete event when the scope ends.  When tracing is off a span is a
+// single relaxed load, and spans are only placed around whole phases,
+// never per state.
+//
+// Every event carries the thread that ran it.  With per_thread lanes
+// each thread gets its own row in the viewer: the main thread is 0,
+// a thread pool can give its workers fixed lanes with setLane (so each
+// worker keeps its row for the whole search), and any other thread is
+// numbered when it first records a span.  Otherwise every span is
+// drawn on one row.
+
+class Tracer {
+public:
+  Tracer() : on(false), per_thread(false), next_lane(1) {}
+
+  // start collecting spans, to be written to filename by write()
+  void start(const std::string &filename, bool per_thread_lanes);
+  bool enabled() const { return on.load(std::memory_order_relaxed); }
+  // the lane for spans recorded by the calling thread from now on
+  void setLane(int lane);
+
+  // write every span collected so far; returns false (with error
+  // filled in) if the file cannot be written
+  bool write(std::string &error);
+
+  // called by TraceSpan
+  void record(const char* name, int depth, std::chrono::steady_clock::time_point begin,
+              std::chrono::steady_clock::time_point end);
+
+private:
+  // the lane of the calling thread
+  int lane();
+
+  class Event {
+  public:
+    const char* name;
+    int depth;
+    int lane;
+    double start_us;
+    double duration_us;
+  };
+
+  // REPRESENTATION
+  std::atomic<bool> on;
+  bool per_thread;
+  std::string filename;
+  std::chrono::steady_clock::time_point origin;
+  std::atomic<int> next_lane;
+  std::mutex mutex;
+  std::vector<Event> events;
+};
+
+extern Tracer tracer;
+
+// the name must be a string literal (it is kept, not copied); depth,
+// if not -1, is shown with the span
+class TraceSpan {
+public:
+  TraceSpan(const char* n, int d = -1) : name(n), depth(d), active(tracer.enabled()) {
+    if (active) begin = std::chrono::steady_clock::now();
+  }
+  ~TraceSpan() {
+    if (active) tracer.record(name,depth,begin,std::chrono::steady_clock::now());
+  }
+private:
+  // disallow copying
+  TraceSpan(const TraceSpan&);
+  TraceSpan& operator=(const TraceSpan&);
+
+  const char* name;
+  int depth;
+  bool active;
+  std::chrono::steady_clock::time_point begin;
+};
+
+#endif